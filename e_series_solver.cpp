@@ -0,0 +1,2155 @@
+﻿/*
+* Implementation of the E-series solver of the find E tool, see e_series_solver.h
+* 
+* Copyright 2024 M_Marvin (Discord, GitHub)
+* 
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*/
+
+#include "e_series_solver.h"
+
+#include <vector>
+#include <array>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <bit>
+#include <math.h>
+#include <stdint.h>
+
+// Vector instructions for the batched nearest value search
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FIND_E_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FIND_E_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FIND_E_NEON
+#endif
+
+// Prefetching for the inventory search
+#if defined(__GNUC__)
+#define FIND_E_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(FIND_E_AVX2) || defined(FIND_E_SSE2)
+#define FIND_E_PREFETCH(p) _mm_prefetch((const char*) (p), _MM_HINT_T0)
+#else
+#define FIND_E_PREFETCH(p)
+#endif
+
+// For mapping the index file
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/* For historical reasons, these E-series do not match the actual equation, and need to be defined by fixed values */
+static constexpr double E3[] = {1.0, 2.2, 4.7};
+static constexpr double E6[] = {1.0, 1.5, 2.2, 3.3, 4.7, 6.8};
+static constexpr double E12[] = {1.0, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2};
+static constexpr double E24[] = {1.0, 1.1, 1.2, 1.3, 1.5, 1.6, 1.8, 2.0, 2.2, 2.4, 2.7, 3.0, 3.3, 3.6, 3.9, 4.3, 4.7, 5.1, 5.6, 6.2, 6.8, 7.5, 8.2, 9.1};
+
+/* The precision series as published in IEC 60063, with three significant digits instead of the three decimals of the equation used for the larger series */
+static constexpr double E48[] = {
+	1.00, 1.05, 1.10, 1.15, 1.21, 1.27, 1.33, 1.40, 1.47, 1.54, 1.62, 1.69, 1.78, 1.87, 1.96, 2.05, 2.15, 2.26, 2.37, 2.49, 2.61, 2.74, 2.87, 3.01,
+	3.16, 3.32, 3.48, 3.65, 3.83, 4.02, 4.22, 4.42, 4.64, 4.87, 5.11, 5.36, 5.62, 5.90, 6.19, 6.49, 6.81, 7.15, 7.50, 7.87, 8.25, 8.66, 9.09, 9.53
+};
+static constexpr double E96[] = {
+	1.00, 1.02, 1.05, 1.07, 1.10, 1.13, 1.15, 1.18, 1.21, 1.24, 1.27, 1.30, 1.33, 1.37, 1.40, 1.43, 1.47, 1.50, 1.54, 1.58, 1.62, 1.65, 1.69, 1.74,
+	1.78, 1.82, 1.87, 1.91, 1.96, 2.00, 2.05, 2.10, 2.15, 2.21, 2.26, 2.32, 2.37, 2.43, 2.49, 2.55, 2.61, 2.67, 2.74, 2.80, 2.87, 2.94, 3.01, 3.09,
+	3.16, 3.24, 3.32, 3.40, 3.48, 3.57, 3.65, 3.74, 3.83, 3.92, 4.02, 4.12, 4.22, 4.32, 4.42, 4.53, 4.64, 4.75, 4.87, 4.99, 5.11, 5.23, 5.36, 5.49,
+	5.62, 5.76, 5.90, 6.04, 6.19, 6.34, 6.49, 6.65, 6.81, 6.98, 7.15, 7.32, 7.50, 7.68, 7.87, 8.06, 8.25, 8.45, 8.66, 8.87, 9.09, 9.31, 9.53, 9.76
+};
+static constexpr double E192[] = {
+	1.00, 1.01, 1.02, 1.04, 1.05, 1.06, 1.07, 1.09, 1.10, 1.11, 1.13, 1.14, 1.15, 1.17, 1.18, 1.20, 1.21, 1.23, 1.24, 1.26, 1.27, 1.29, 1.30, 1.32,
+	1.33, 1.35, 1.37, 1.38, 1.40, 1.42, 1.43, 1.45, 1.47, 1.49, 1.50, 1.52, 1.54, 1.56, 1.58, 1.60, 1.62, 1.64, 1.65, 1.67, 1.69, 1.72, 1.74, 1.76,
+	1.78, 1.80, 1.82, 1.84, 1.87, 1.89, 1.91, 1.93, 1.96, 1.98, 2.00, 2.03, 2.05, 2.08, 2.10, 2.13, 2.15, 2.18, 2.21, 2.23, 2.26, 2.29, 2.32, 2.34,
+	2.37, 2.40, 2.43, 2.46, 2.49, 2.52, 2.55, 2.58, 2.61, 2.64, 2.67, 2.71, 2.74, 2.77, 2.80, 2.84, 2.87, 2.91, 2.94, 2.98, 3.01, 3.05, 3.09, 3.12,
+	3.16, 3.20, 3.24, 3.28, 3.32, 3.36, 3.40, 3.44, 3.48, 3.52, 3.57, 3.61, 3.65, 3.70, 3.74, 3.79, 3.83, 3.88, 3.92, 3.97, 4.02, 4.07, 4.12, 4.17,
+	4.22, 4.27, 4.32, 4.37, 4.42, 4.48, 4.53, 4.59, 4.64, 4.70, 4.75, 4.81, 4.87, 4.93, 4.99, 5.05, 5.11, 5.17, 5.23, 5.30, 5.36, 5.42, 5.49, 5.56,
+	5.62, 5.69, 5.76, 5.83, 5.90, 5.97, 6.04, 6.12, 6.19, 6.26, 6.34, 6.42, 6.49, 6.57, 6.65, 6.73, 6.81, 6.90, 6.98, 7.06, 7.15, 7.23, 7.32, 7.41,
+	7.50, 7.59, 7.68, 7.77, 7.87, 7.96, 8.06, 8.16, 8.25, 8.35, 8.45, 8.56, 8.66, 8.77, 8.87, 8.98, 9.09, 9.20, 9.31, 9.42, 9.53, 9.65, 9.76, 9.88
+};
+
+/*
+* Compile time replacement for pow(10, x), only valid for x in the range 0.0 - 1.0
+* The exponent is reduced by 2^10 before evaluating the taylor series of exp(), and the result squared back up afterwards.
+*/
+constexpr double constexprPow10(double x) {
+	double y = x * 2.302585092994045684 / 1024.0;
+	double term = 1.0;
+	double sum = 1.0;
+	for (int i = 1; i < 12; i++) {
+		term *= y / i;
+		sum += term;
+	}
+	for (int i = 0; i < 10; i++) sum *= sum;
+	return sum;
+}
+
+/*
+* Generates the values 10^(m/N) of an computed E-series at compile time, rounded to three digits.
+* Only the values of the first decade (1.0 - <10.0) are generated, the same as for the fixed series.
+*/
+template<uint16_t N>
+constexpr array<double, N> generateSeries() {
+	array<double, N> ser = {};
+	for (uint16_t m = 0; m < N; m++) {
+		ser[m] = (double) (int64_t) (constexprPow10((double) m / N) * 1000.0 + 0.5) / 1000.0;
+	}
+	return ser;
+}
+
+template<uint16_t N>
+static constexpr array<double, N> ESeries = generateSeries<N>();
+
+/*
+* Generates the values of a series as integer milli-mantissas (1000 - 9999), which all series values are exactly.
+* The searches for the nearest value compare against these, a quarter of the size of the values and without any floating point compare.
+* One more entry holds the first value of the next decade (10000), so that the searches can always read two neighbouring entries.
+*/
+template<uint16_t N>
+constexpr array<uint16_t, N + 1> generateMilli(const double* ser) {
+	array<uint16_t, N + 1> milli = {};
+	for (uint16_t m = 0; m < N; m++) milli[m] = (uint16_t) (ser[m] * 1000.0 + 0.5);
+	milli[N] = 10000;
+	return milli;
+}
+
+template<uint16_t N, const double* Ser>
+static constexpr array<uint16_t, N + 1> EMilli = generateMilli<N>(Ser);
+
+template<uint16_t N>
+static constexpr array<uint16_t, N + 1> ESeriesMilli = generateMilli<N>(ESeries<N>.data());
+
+/*
+* Returns the milli-mantissa key to search for a value, a series entry is smaller than the value exactly if it is smaller than the key.
+* The key can be off by one for values within rounding distance of a series value, which only moves the search by one entry between the same two neighbours.
+*/
+inline int32_t milliKey(double v) {
+	return (int32_t) ceil(v * 1000.0);
+}
+
+/*
+* Returns the value with index m of a series, index n is the first value of the next decade (10.0)
+*/
+constexpr double seriesValue(const double* ser, uint16_t n, uint16_t m) {
+	return m < n ? ser[m] : ser[m - n] * 10.0;
+}
+
+/*
+* Generates the powers of ten 10^0 - 10^308 at compile time.
+* Everything above 10^22 is composed from exact powers, to keep the rounding errors small.
+*/
+constexpr array<double, 309> generatePowersOfTen() {
+	array<double, 309> pow10 = {};
+	pow10[0] = 1.0;
+	for (int k = 1; k < 309; k++) {
+		pow10[k] = k <= 22 ? pow10[k - 1] * 10.0 : pow10[22] * pow10[k - 22];
+	}
+	return pow10;
+}
+
+static constexpr array<double, 309> POW10 = generatePowersOfTen();
+
+// Counting is compiled out unless enabled, the counters are per thread so that the queries do not share cache lines
+#if defined(FIND_E_STATS)
+static thread_local SolverStats threadStats = {};
+#define FIND_E_COUNT(counter, n) (threadStats.counter += (n))
+#else
+static const SolverStats threadStats = {};
+#define FIND_E_COUNT(counter, n) ((void) 0)
+#endif
+
+const SolverStats& solverStats() {
+	return threadStats;
+}
+
+double scaleDecade(double d, int e) {
+	FIND_E_COUNT(powerCalls, 1);
+	// Subnormal values need two steps in both directions, since the power of ten for their decade is out of range
+	double s = e > 308 ? d * POW10[308] : e < -308 ? d / POW10[308] : d;
+	e = e > 308 ? e - 308 : e < -308 ? e + 308 : e;
+	return e >= 0 ? s * POW10[e] : s / POW10[-e];
+}
+
+/*
+* The decade is estimated from the binary exponent, which is at most one decade too low, and corrected with a single comparison.
+* Values whose power of ten is inexact can end up just below 1.0, these are clamped to 1.0.
+*/
+double cutDown(double d, int* exponent) {
+
+	if (!(d > 0.0) || isinf(d)) {
+		*exponent = 0;
+		return 0.0;
+	}
+
+	int binary;
+	frexp(d, &binary);
+	int e = (int) floor((binary - 1) * 0.30102999566398120);
+
+	double m = scaleDecade(d, -e);
+	bool above = m >= 10.0;
+	*exponent = above ? e + 1 : e;
+	return max(above ? scaleDecade(d, -e - 1) : m, 1.0);
+
+}
+
+/*
+* Builds a sorted table of all ratios that can be made from two values of the provided series.
+* All ratios are transformed to 1.0 - 10.0, by multiplying the first value by 10 where required.
+* @param ser The values of the series
+* @param n The size of the series
+* @returns The ratio entries, sorted by ratio
+*/
+vector<RatioEntry> buildRatioIndex(const double* ser, uint16_t n) {
+
+	vector<RatioEntry> index = vector<RatioEntry>();
+	index.reserve((size_t) n * n);
+
+	for (uint16_t e1 = 0; e1 < n; e1++) {
+		for (uint16_t e2 = 0; e2 < n; e2++) {
+			double value1 = ser[e1] < ser[e2] ? ser[e1] * 10.0 : ser[e1];
+			index.push_back({ value1 / ser[e2], value1, ser[e2], n });
+		}
+	}
+
+	sort(index.begin(), index.end(), [](const RatioEntry& a, const RatioEntry& b) { return a.ratio < b.ratio; });
+	return index;
+
+}
+
+/*
+* Searches the ratio index for the entry closest to the requested ratio.
+* Since the ratios repeat every decade, the first and last entries are also compared across the decade boundary.
+* @param index The ratio index to search in
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param error Returns the error of the closest entry
+* @returns The closest entry, with its values scaled to match the ratio's decade
+*/
+RatioEntry findClosestRatio(span<const RatioEntry> index, double r, double* error) {
+
+	FIND_E_COUNT(indexSearches, 1);
+	FIND_E_COUNT(candidates, 2);
+	auto upper = lower_bound(index.begin(), index.end(), r, [](const RatioEntry& e, double r) { return e.ratio < r; });
+
+	RatioEntry candidates[2];
+	if (upper == index.end()) {
+		const RatioEntry& first = index.front();
+		candidates[0] = { first.ratio * 10.0, first.value1 * 10.0, first.value2, first.series };
+	} else {
+		candidates[0] = *upper;
+	}
+	if (upper == index.begin()) {
+		const RatioEntry& last = index.back();
+		candidates[1] = { last.ratio / 10.0, last.value1, last.value2 * 10.0, last.series };
+	} else {
+		candidates[1] = *(upper - 1);
+	}
+
+	double err0 = abs(candidates[0].ratio - r) / r;
+	double err1 = abs(candidates[1].ratio - r) / r;
+	*error = min(err0, err1);
+	return err0 <= err1 ? candidates[0] : candidates[1];
+
+}
+
+/*
+* Keeps the best pairs offered during a ranked ratio search, in a bounded heap with the worst pair on top.
+*/
+class RatioCandidates {
+
+public:
+	RatioCandidates(span<RatioMatch> storage, double maxError) : storage(storage), count(0), maxError(maxError) {}
+
+	/*
+	* Returns true if a pair with this error could still enter the candidates.
+	*/
+	bool accepts(double error) const {
+		return error <= maxError && (count < storage.size() || error <= storage[0].error);
+	}
+
+	void offer(const RatioMatch& match) {
+		if (storage.empty() || !accepts(match.error)) return;
+		if (count == storage.size() && !better(match, storage[0])) return;
+		for (size_t i = 0; i < count; i++) {
+			if (storage[i].value1 == match.value1 && storage[i].value2 == match.value2) return;
+		}
+		if (count == storage.size()) {
+			pop_heap(storage.begin(), storage.begin() + count, better);
+			count--;
+		}
+		storage[count++] = match;
+		push_heap(storage.begin(), storage.begin() + count, better);
+	}
+
+	/*
+	* Sorts the candidates, best first, and returns their number.
+	*/
+	size_t finish() {
+		sort_heap(storage.begin(), storage.begin() + count, better);
+		return count;
+	}
+
+private:
+	span<RatioMatch> storage;
+	size_t count;
+	double maxError;
+
+	/*
+	* Returns true if a ranks before b, by error, then series size and then value.
+	*/
+	static bool better(const RatioMatch& a, const RatioMatch& b) {
+		if (a.error != b.error) return a.error < b.error;
+		if (a.series != b.series) return a.series < b.series;
+		return a.value1 < b.value1;
+	}
+
+};
+
+/*
+* Returns the entry at position i of the ratio index, continued into the decades below and above for positions outside the index.
+*/
+RatioEntry ratioEntryAt(span<const RatioEntry> index, ptrdiff_t i) {
+	ptrdiff_t size = (ptrdiff_t) index.size();
+	if (i < 0) {
+		const RatioEntry& e = index[i + size];
+		return { e.ratio / 10.0, e.value1, e.value2 * 10.0, e.series };
+	} else if (i >= size) {
+		const RatioEntry& e = index[i - size];
+		return { e.ratio * 10.0, e.value1 * 10.0, e.value2, e.series };
+	}
+	return index[i];
+}
+
+/*
+* Offers the pairs of one of the fixed E-series closest to the requested ratio, walking outwards from the ratio in the index.
+* Both directions stop at the first pair that can not enter the candidates anymore, the errors only grow from there.
+* @param index The ratio index of the series
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param candidates The candidates to offer the pairs to
+*/
+void rankFixedPairsForRatio(span<const RatioEntry> index, double r, RatioCandidates& candidates) {
+
+	FIND_E_COUNT(indexSearches, 1);
+	ptrdiff_t size = (ptrdiff_t) index.size();
+	ptrdiff_t above = lower_bound(index.begin(), index.end(), r, [](const RatioEntry& e, double r) { return e.ratio < r; }) - index.begin();
+	ptrdiff_t below = above - 1;
+
+	for (ptrdiff_t steps = 0; steps < size; steps++) {
+		RatioEntry up = ratioEntryAt(index, above);
+		RatioEntry down = ratioEntryAt(index, below);
+		double upError = abs(up.ratio - r) / r;
+		double downError = abs(down.ratio - r) / r;
+		FIND_E_COUNT(candidates, 1);
+
+		bool takeUp = upError <= downError;
+		double err = takeUp ? upError : downError;
+		if (!candidates.accepts(err)) return;
+
+		const RatioEntry& entry = takeUp ? up : down;
+		candidates.offer({ err, entry.value1, entry.value2, entry.series });
+		if (takeUp) {
+			above++;
+		} else {
+			below--;
+		}
+	}
+
+}
+
+/*
+* Searches the best pair of values for the requested ratio in one of the fixed E-series, using its ratio index.
+* @param index The ratio index of the series
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param error Returns the error of the best pair
+* @param value1 Returns the first value of the best pair
+* @param value2 Returns the second value of the best pair
+*/
+void findFixedPairForRatio(span<const RatioEntry> index, double r, double* error, double* value1, double* value2) {
+	RatioEntry entry = findClosestRatio(index, r, error);
+	*value1 = entry.value1;
+	*value2 = entry.value2;
+}
+
+/*
+* Calls the visitor with the error and the values of the pairs of an computed E-series closest to the requested ratio.
+* The rounding of the values to three digits moves a ratio by up to 0.1 %, far more than the step of the larger series, so the closest pair
+* can have any index difference and no window derived from the ideal ratio r10^(e1-e2) is safe. Instead, for every second value in
+* 1.0 - 10.0 the first value is walked outwards from r * value2, over the decade above the second value. That position only moves up
+* as the second value grows, so the whole series takes a single pass. Both directions stop once the visitor returns false,
+* the errors only grow from there.
+*/
+template<uint16_t N, typename Visitor>
+void forComputedPairs(double r, Visitor visit) {
+
+	const double* ser = ESeries<N>.data();
+
+	// The first index whose value is not below r * value2, at most one decade above the second value
+	uint16_t above = 0;
+	for (uint16_t e2 = 0; e2 < N; e2++) {
+		double v2 = ser[e2];
+		double target = r * v2;
+		if (above < e2) above = e2;
+		while (above < e2 + N && seriesValue(ser, N, above) < target) above++;
+
+		for (uint16_t e1 = above; e1 <= e2 + N; e1++) {
+			double v1 = seriesValue(ser, N, e1);
+			FIND_E_COUNT(candidates, 1);
+			if (!visit(abs(v1 / v2 - r) / r, v1, v2)) break;
+		}
+		for (uint16_t e1 = above; e1-- > e2;) {
+			double v1 = seriesValue(ser, N, e1);
+			FIND_E_COUNT(candidates, 1);
+			if (!visit(abs(v1 / v2 - r) / r, v1, v2)) break;
+		}
+	}
+
+}
+
+/*
+* Searches the best pair of values for the requested ratio in an computed E-series.
+* Only the closest pair in each direction is needed for every second value, see forComputedPairs.
+* The computed series have no ratio index, the unnamed parameter only keeps the signature of SeriesDescriptor::matchRatio.
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param error Returns the error of the best pair
+* @param value1 Returns the first value of the best pair
+* @param value2 Returns the second value of the best pair
+*/
+template<uint16_t N>
+void findComputedPairForRatio(span<const RatioEntry>, double r, double* error, double* value1, double* value2) {
+
+	*error = -1.0;
+	forComputedPairs<N>(r, [&](double err, double v1, double v2) {
+		if (err < *error || *error < 0) {
+			*error = err;
+			*value1 = v1;
+			*value2 = v2;
+		}
+		return false;
+	});
+
+}
+
+/*
+* Offers the pairs of an computed E-series closest to the requested ratio, walking outwards from every second value's closest pair
+* until a pair can not enter the candidates anymore, the same way as rankFixedPairsForRatio.
+* The unnamed parameter is the ratio index the computed series do not have, see findComputedPairForRatio.
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param candidates The candidates to offer the pairs to
+*/
+template<uint16_t N>
+void rankComputedPairsForRatio(span<const RatioEntry>, double r, RatioCandidates& candidates) {
+	forComputedPairs<N>(r, [&](double err, double v1, double v2) {
+		if (!candidates.accepts(err)) return false;
+		candidates.offer({ err, v1, v2, N });
+		return true;
+	});
+}
+
+/* The largest series for which the network index is built, above that the two value ratios are already close enough */
+static constexpr uint16_t NETWORK_SERIES_LIMIT = 96;
+
+/* The second value of a pair in the network index can be up to this many decades above the first one */
+static constexpr int NETWORK_DECADES = 2;
+
+double networkValue(const NetworkHalf& half) {
+	switch (half.branch) {
+		case BRANCH_SERIES: return half.value1 + half.value2;
+		case BRANCH_PARALLEL: return half.value1 * half.value2 / (half.value1 + half.value2);
+		default: return half.value1;
+	}
+}
+
+/*
+* Builds the network halves made from single values of the provided series, sorted by mantissa.
+*/
+vector<NetworkHalf> buildNetworkSingles(const double* ser, uint16_t n) {
+	vector<NetworkHalf> singles = vector<NetworkHalf>(n);
+	for (uint16_t e = 0; e < n; e++) singles[e] = { ser[e], ser[e], 0.0, BRANCH_SINGLE };
+	return singles;
+}
+
+/*
+* Builds the network halves made from two values of the provided series in series or parallel, sorted by the mantissa of their combined value.
+* The second value is taken from the same decade as the first, or up to NETWORK_DECADES above it.
+* @param ser The values of the series
+* @param n The size of the series
+* @returns The network halves, sorted by mantissa
+*/
+vector<NetworkHalf> buildNetworkPairs(const double* ser, uint16_t n) {
+
+	vector<NetworkHalf> pairs = vector<NetworkHalf>();
+	pairs.reserve((size_t) n * n * (2 * NETWORK_DECADES + 1));
+
+	for (int decade = 0; decade <= NETWORK_DECADES; decade++) {
+		for (uint16_t e1 = 0; e1 < n; e1++) {
+			// Within the same decade, the pairs are symmetric
+			for (uint16_t e2 = decade == 0 ? e1 : 0; e2 < n; e2++) {
+				double value2 = scaleDecade(ser[e2], decade);
+				for (NetworkBranch branch : { BRANCH_SERIES, BRANCH_PARALLEL }) {
+					NetworkHalf half = { 0.0, ser[e1], value2, branch };
+					int exponent;
+					half.mantissa = cutDown(networkValue(half), &exponent);
+					pairs.push_back(half);
+				}
+			}
+		}
+	}
+
+	sort(pairs.begin(), pairs.end(), [](const NetworkHalf& a, const NetworkHalf& b) { return a.mantissa < b.mantissa; });
+	return pairs;
+
+}
+
+/*
+* Calls the visitor for every half whose mantissa is within the bound of the target, in this decade or the ones next to it.
+* The visitor receives the half and its error against the target.
+* The bound is read again for every half, so the visitor can tighten it while the halves are scanned.
+*/
+template<typename Visitor>
+void scanNetworkWindow(span<const NetworkHalf> halves, double target, const double& bound, Visitor visit) {
+
+	for (double factor : { 1.0, 0.1, 10.0 }) {
+		double t = target * factor;
+		if (t * (1.0 + bound) < 1.0 || t * (1.0 - bound) >= 10.0) continue;
+
+		FIND_E_COUNT(indexSearches, 1);
+		auto it = lower_bound(halves.begin(), halves.end(), t * (1.0 - bound), [](const NetworkHalf& h, double m) { return h.mantissa < m; });
+		for (; it != halves.end() && it->mantissa <= t * (1.0 + bound); it++) {
+			FIND_E_COUNT(candidates, 1);
+			visit(*it, abs(it->mantissa - t) / t);
+		}
+	}
+
+}
+
+/*
+* Searches the best combination of an upper and a lower half for the requested ratio, using branch and bound.
+* For every lower half only the upper halves within the error of the best combination so far are scanned.
+* @param upper The candidates for the upper half, sorted by mantissa
+* @param lower The candidates for the lower half
+* @param r The requested ratio, transformed to 1.0 - 10.0
+* @param bound The error bound, returns the error of the best combination if one was found
+* @param network Returns the best combination, if one within the bound was found
+* @returns true if a combination within the bound was found
+*/
+bool findNetworkForRatio(span<const NetworkHalf> upper, span<const NetworkHalf> lower, double r, double* bound, NetworkMatch* network) {
+
+	bool found = false;
+	for (const NetworkHalf& l : lower) {
+		scanNetworkWindow(upper, r * l.mantissa, *bound, [&](const NetworkHalf& u, double err) {
+			if (err <= *bound && (!found || err < network->error)) {
+				network->error = err;
+				network->upper = u;
+				network->lower = l;
+				*bound = err;
+				found = true;
+			}
+		});
+	}
+	return found;
+
+}
+
+/* Number of buckets per decade in the nearest value lookup tables of the fixed series */
+static constexpr int LOOKUP_BUCKETS = 256;
+
+/*
+* Fills the nearest value lookup table of a series, at compile time for the fixed E-series and at runtime for custom series.
+* Each bucket covers an equal range of log10(v) and holds the index of the value closest to the lower end of the bucket.
+* The bucket size has to be small enough that the next index is the only other value that can be closer within the bucket.
+* @returns false if the values are too close for the buckets, the table can not be used then
+*/
+constexpr bool fillLookup(const double* ser, uint16_t n, uint8_t* lookup) {
+	if (n > UINT8_MAX) return false;
+	uint8_t m = 0;
+	for (int b = 0; b < LOOKUP_BUCKETS; b++) {
+		// Slightly below the bucket boundary, so that rounding of log10() at runtime can not skip a value
+		double v = constexprPow10((double) b / LOOKUP_BUCKETS) * (1.0 - 1e-9);
+		while (m < n && seriesValue(ser, n, m + 1) - v < v - seriesValue(ser, n, m)) m++;
+		if (b > 0 && m > lookup[b - 1] + 1) return false;
+		lookup[b] = m;
+	}
+	return true;
+}
+
+template<uint16_t N, const double* Ser>
+constexpr array<uint8_t, LOOKUP_BUCKETS> generateLookup() {
+	array<uint8_t, LOOKUP_BUCKETS> lookup = {};
+	if (!fillLookup(Ser, N, lookup.data())) throw "lookup buckets too large for series";
+	return lookup;
+}
+
+template<uint16_t N, const double* Ser>
+static constexpr array<uint8_t, LOOKUP_BUCKETS> ELookup = generateLookup<N, Ser>();
+
+/*
+* Finds the index of the series value closest to the provided value.
+* Uses the nearest value lookup table if the series has one, and a branchless binary search over the milli-mantissas otherwise.
+* @param ser The values of the series
+* @param milli The milli-mantissas of the series
+* @param n The size of the series
+* @param lookup The nearest value lookup table of the series, or nullptr
+* @param v The value, transformed to 1.0 - 10.0
+* @returns The index of the closest value, n if the first value of the next decade is the closest
+*/
+inline uint16_t nearestValue(const double* ser, const uint16_t* milli, uint16_t n, const uint8_t* lookup, double v) {
+
+	uint16_t m;
+	if (lookup != nullptr) {
+		FIND_E_COUNT(lookupHits, 1);
+		FIND_E_COUNT(powerCalls, 1);
+		int b = (int) (log10(v) * LOOKUP_BUCKETS);
+		m = lookup[min(max(b, 0), LOOKUP_BUCKETS - 1)];
+	} else {
+		FIND_E_COUNT(indexSearches, 1);
+		int32_t key = milliKey(v);
+		const uint16_t* base = milli;
+		for (uint16_t len = n; len > 1; ) {
+			uint16_t half = len / 2;
+			base = base[half] < key ? base + half : base;
+			len -= half;
+		}
+		m = (uint16_t) (base - milli) + (*base < key);
+		if (m > 0) m--;
+	}
+
+	if (m < n && seriesValue(ser, n, m + 1) - v < v - seriesValue(ser, n, m)) m++;
+	return m;
+
+}
+
+#if defined(FIND_E_AVX2)
+
+/*
+* Returns the largest of the four values
+*/
+inline double horizontalMax(__m256d v) {
+	__m128d m = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_max_sd(m, _mm_unpackhi_pd(m, m)));
+}
+
+#endif
+
+/*
+* Finds the series values closest to a batch of values, and their errors.
+* Four (AVX2) or two (SSE2, NEON) values are processed at once, using a branchless binary search over the milli-mantissas of the series.
+* Only the two neighbours found are compared as values, so the results are the same as when searching the values themselves.
+* The remaining values, and all values on other platforms, are processed one by one.
+* The search stops early once an error reaches the bound, the series can not match anymore then.
+* The size is a template parameter for the built-in series, so that the searches are unrolled for them, N = 0 takes it from n instead.
+* @param ser The values of the series
+* @param n The size of the series, only used if N is 0
+* @param milli The milli-mantissas of the series
+* @param lookup The nearest value lookup table of the series, or nullptr
+* @param mantissas The values, transformed to 1.0 - 10.0
+* @param count The number of values
+* @param indices Returns the index of the closest series value for each value, n for the first value of the next decade
+* @param errors Returns the error of the closest series value for each value
+* @param bound The error at which the search stops, the indices and errors are incomplete then
+* @returns The largest error that occurred, at least the bound if the search stopped early
+*/
+template<uint16_t N>
+double nearestSeriesValues(const double* ser, uint16_t n, const uint16_t* milli, const uint8_t* lookup, const double* mantissas, size_t count, uint16_t* indices, double* errors, double bound) {
+
+	if (N != 0) n = N;
+	double largestError = 0.0;
+	size_t i = 0;
+
+#if defined(FIND_E_AVX2)
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi64x(1);
+	const __m256i size = _mm256_set1_epi64x(n);
+	const __m128i low16 = _mm_set1_epi32(0xFFFF);
+	const __m256d thousand = _mm256_set1_pd(1000.0);
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d limit = _mm256_set1_pd(bound);
+	__m256d maxError = _mm256_setzero_pd();
+
+	for (; i + 4 <= count; i += 4) {
+		__m256d v = _mm256_loadu_pd(mantissas + i);
+		FIND_E_COUNT(indexSearches, 4);
+
+		// Find the first value not smaller than v, gathering 32 bits at each milli-mantissa and keeping the lower 16
+		__m128i key = _mm256_cvtpd_epi32(_mm256_ceil_pd(_mm256_mul_pd(v, thousand)));
+		__m128i milliBase = _mm_setzero_si128();
+		for (uint16_t len = n; len > 1; ) {
+			uint16_t half = len / 2;
+			__m128i probe = _mm_add_epi32(milliBase, _mm_set1_epi32(half));
+			__m128i probed = _mm_and_si128(_mm_i32gather_epi32((const int*) milli, probe, 2), low16);
+			milliBase = _mm_blendv_epi8(milliBase, probe, _mm_cmpgt_epi32(key, probed));
+			len -= half;
+		}
+		__m128i probed = _mm_and_si128(_mm_i32gather_epi32((const int*) milli, milliBase, 2), low16);
+		__m256i base = _mm256_cvtepi32_epi64(milliBase);
+		__m256i less = _mm256_cvtepi32_epi64(_mm_cmpgt_epi32(key, probed));
+		__m256i high = _mm256_sub_epi64(base, less);
+		__m256i low = _mm256_andnot_si256(_mm256_cmpeq_epi64(high, zero), _mm256_sub_epi64(high, one));
+
+		// Compare against the values below and above, the value above can be the first value of the next decade
+		__m256i wrap = _mm256_cmpeq_epi64(high, size);
+		__m256d highValue = _mm256_i64gather_pd(ser, _mm256_andnot_si256(wrap, high), 8);
+		highValue = _mm256_blendv_pd(highValue, _mm256_mul_pd(highValue, _mm256_set1_pd(10.0)), _mm256_castsi256_pd(wrap));
+		__m256d lowValue = _mm256_i64gather_pd(ser, low, 8);
+
+		__m256d lowDistance = _mm256_andnot_pd(sign, _mm256_sub_pd(v, lowValue));
+		__m256d highDistance = _mm256_andnot_pd(sign, _mm256_sub_pd(highValue, v));
+		__m256d takeHigh = _mm256_cmp_pd(highDistance, lowDistance, _CMP_LT_OQ);
+
+		__m256d error = _mm256_div_pd(_mm256_blendv_pd(lowDistance, highDistance, takeHigh), v);
+		_mm256_storeu_pd(errors + i, error);
+		maxError = _mm256_max_pd(maxError, error);
+
+		alignas(32) int64_t index[4];
+		_mm256_store_si256((__m256i*) index, _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(low), _mm256_castsi256_pd(high), takeHigh)));
+		for (int l = 0; l < 4; l++) indices[i + l] = (uint16_t) index[l];
+
+		if (_mm256_movemask_pd(_mm256_cmp_pd(error, limit, _CMP_GE_OQ))) return horizontalMax(maxError);
+	}
+
+	largestError = horizontalMax(maxError);
+
+#elif defined(FIND_E_SSE2)
+
+	const __m128d sign = _mm_set1_pd(-0.0);
+	const __m128d limit = _mm_set1_pd(bound);
+	__m128d maxError = _mm_setzero_pd();
+
+	for (; i + 2 <= count; i += 2) {
+		__m128d v = _mm_loadu_pd(mantissas + i);
+		FIND_E_COUNT(indexSearches, 2);
+
+		// Find the first value not smaller than v, SSE2 has no gather so the indices are kept in scalar registers
+		int32_t key0 = milliKey(mantissas[i]), key1 = milliKey(mantissas[i + 1]);
+		uint16_t base0 = 0, base1 = 0;
+		for (uint16_t len = n; len > 1; ) {
+			uint16_t half = len / 2;
+			base0 += milli[base0 + half] < key0 ? half : 0;
+			base1 += milli[base1 + half] < key1 ? half : 0;
+			len -= half;
+		}
+		uint16_t high0 = base0 + (milli[base0] < key0), high1 = base1 + (milli[base1] < key1);
+		uint16_t low0 = high0 > 0 ? high0 - 1 : 0, low1 = high1 > 0 ? high1 - 1 : 0;
+
+		// Compare against the values below and above, the value above can be the first value of the next decade
+		__m128d lowValue = _mm_set_pd(ser[low1], ser[low0]);
+		__m128d highValue = _mm_set_pd(seriesValue(ser, n, high1), seriesValue(ser, n, high0));
+		__m128d lowDistance = _mm_andnot_pd(sign, _mm_sub_pd(v, lowValue));
+		__m128d highDistance = _mm_andnot_pd(sign, _mm_sub_pd(highValue, v));
+		__m128d takeHigh = _mm_cmplt_pd(highDistance, lowDistance);
+
+		__m128d error = _mm_div_pd(_mm_or_pd(_mm_and_pd(takeHigh, highDistance), _mm_andnot_pd(takeHigh, lowDistance)), v);
+		_mm_storeu_pd(errors + i, error);
+		maxError = _mm_max_pd(maxError, error);
+
+		int take = _mm_movemask_pd(takeHigh);
+		indices[i] = (take & 1) ? high0 : low0;
+		indices[i + 1] = (take & 2) ? high1 : low1;
+
+		if (_mm_movemask_pd(_mm_cmpge_pd(error, limit))) return _mm_cvtsd_f64(_mm_max_sd(maxError, _mm_unpackhi_pd(maxError, maxError)));
+	}
+
+	largestError = _mm_cvtsd_f64(_mm_max_sd(maxError, _mm_unpackhi_pd(maxError, maxError)));
+
+#elif defined(FIND_E_NEON)
+
+	const float64x2_t limit = vdupq_n_f64(bound);
+	float64x2_t maxError = vdupq_n_f64(0.0);
+
+	for (; i + 2 <= count; i += 2) {
+		float64x2_t v = vld1q_f64(mantissas + i);
+		FIND_E_COUNT(indexSearches, 2);
+
+		// Find the first value not smaller than v, the indices are kept in scalar registers since there are no gathers
+		int32_t key0 = milliKey(mantissas[i]), key1 = milliKey(mantissas[i + 1]);
+		uint16_t base0 = 0, base1 = 0;
+		for (uint16_t len = n; len > 1; ) {
+			uint16_t half = len / 2;
+			base0 += milli[base0 + half] < key0 ? half : 0;
+			base1 += milli[base1 + half] < key1 ? half : 0;
+			len -= half;
+		}
+		uint16_t high0 = base0 + (milli[base0] < key0), high1 = base1 + (milli[base1] < key1);
+		uint16_t low0 = high0 > 0 ? high0 - 1 : 0, low1 = high1 > 0 ? high1 - 1 : 0;
+
+		// Compare against the values below and above, the value above can be the first value of the next decade
+		const double highValues[2] = { seriesValue(ser, n, high0), seriesValue(ser, n, high1) };
+		float64x2_t lowValue = vcombine_f64(vld1_f64(ser + low0), vld1_f64(ser + low1));
+		float64x2_t highValue = vld1q_f64(highValues);
+		float64x2_t lowDistance = vabdq_f64(v, lowValue);
+		float64x2_t highDistance = vabdq_f64(highValue, v);
+		uint64x2_t takeHigh = vcltq_f64(highDistance, lowDistance);
+
+		float64x2_t error = vdivq_f64(vbslq_f64(takeHigh, highDistance, lowDistance), v);
+		vst1q_f64(errors + i, error);
+		maxError = vmaxq_f64(maxError, error);
+
+		indices[i] = vgetq_lane_u64(takeHigh, 0) ? high0 : low0;
+		indices[i + 1] = vgetq_lane_u64(takeHigh, 1) ? high1 : low1;
+
+		if (vmaxvq_u32(vreinterpretq_u32_u64(vcgeq_f64(error, limit)))) return vmaxvq_f64(maxError);
+	}
+
+	largestError = vmaxvq_f64(maxError);
+
+#endif
+
+	for (; i < count; i++) {
+		double v = mantissas[i];
+		uint16_t m = nearestValue(ser, milli, n, lookup, v);
+		double err = abs(seriesValue(ser, n, m) - v) / v;
+
+		indices[i] = m;
+		errors[i] = err;
+
+		if (err > largestError) {
+			largestError = err;
+			if (err >= bound) break;
+		}
+	}
+	return largestError;
+
+}
+
+/*
+* Describes one E-series, with the functions specialized for its size.
+*/
+struct SeriesDescriptor {
+	uint16_t n;
+	const double* values;
+	const uint16_t* milli;
+	const uint8_t* lookup;
+	double (*matchValues)(const double* ser, uint16_t n, const uint16_t* milli, const uint8_t* lookup, const double* mantissas, size_t count, uint16_t* indices, double* errors, double bound);
+	void (*matchRatio)(span<const RatioEntry> index, double r, double* error, double* value1, double* value2);
+	void (*rankRatio)(span<const RatioEntry> index, double r, RatioCandidates& candidates);
+};
+
+template<uint16_t N, const double* Ser>
+constexpr SeriesDescriptor fixedSeries() {
+	return { N, Ser, EMilli<N, Ser>.data(), ELookup<N, Ser>.data(), nearestSeriesValues<N>, findFixedPairForRatio, rankFixedPairsForRatio };
+}
+
+template<uint16_t N>
+constexpr SeriesDescriptor computedSeries() {
+	return { N, ESeries<N>.data(), ESeriesMilli<N>.data(), nullptr, nearestSeriesValues<N>, findComputedPairForRatio<N>, rankComputedPairsForRatio<N> };
+}
+
+/* All E-series, in the order in which they are tried */
+static constexpr SeriesDescriptor SERIES[] = {
+	fixedSeries<3, E3>(),
+	fixedSeries<6, E6>(),
+	fixedSeries<12, E12>(),
+	fixedSeries<24, E24>(),
+	fixedSeries<48, E48>(),
+	fixedSeries<96, E96>(),
+	fixedSeries<192, E192>(),
+	computedSeries<384>(),
+	computedSeries<768>(),
+	computedSeries<1536>(),
+	computedSeries<3072>(),
+	computedSeries<6144>(),
+	computedSeries<12288>(),
+	computedSeries<24576>()
+};
+
+/*
+* Returns the index of the first computed series, from there on every series contains all values of the one before.
+*/
+constexpr size_t firstComputedSeries() {
+	size_t s = 0;
+	while (s < size(SERIES) && SERIES[s].matchRatio == findFixedPairForRatio) s++;
+	return s;
+}
+
+ESeriesSolver::ESeriesSolver() : ladder(SERIES), firstComputed(firstComputedSeries()) {}
+
+ESeriesSolver::~ESeriesSolver() {}
+
+/*
+* The fixed series get a ratio index, the ratios of the computed series are derived directly.
+* Built by the first ratio search, so that a start with a mapped index file or without any ratio query generates nothing.
+*/
+void ESeriesSolver::buildRatioIndices() const {
+	ratioTables.clear();
+	ratioIndices.clear();
+	ratioTables.reserve(ladder.size());
+	for (const SeriesDescriptor& series : ladder) {
+		if (series.matchRatio == findFixedPairForRatio) {
+			ratioTables.push_back(buildRatioIndex(series.values, series.n));
+		} else {
+			ratioTables.push_back(vector<RatioEntry>());
+		}
+		ratioIndices.push_back(ratioTables.back());
+	}
+}
+
+/* The most values a custom series can have, its ratio index holds the square of this */
+static constexpr size_t CUSTOM_SERIES_LIMIT = 1024;
+
+/*
+* The tables of the custom series, built at runtime in the same layout as the ones of the fixed E-series.
+*/
+struct CustomSeries {
+	vector<vector<double>> values;
+	vector<vector<uint16_t>> milli;
+	vector<array<uint8_t, LOOKUP_BUCKETS>> lookups;
+	vector<SeriesDescriptor> descriptors;
+};
+
+/*
+* The values are reduced to their milli-mantissas first, which every series value has to be exactly for the nearest value searches.
+* Series whose values are too close for the lookup buckets are searched by bisection of the milli-mantissas instead, like the computed series.
+*/
+bool ESeriesSolver::useCustomSeries(const vector<vector<double>>& sets) {
+
+	if (indexFile != nullptr || sets.empty()) return false;
+
+	unique_ptr<CustomSeries> custom = make_unique<CustomSeries>();
+	for (const vector<double>& set : sets) {
+		vector<uint16_t> milli = vector<uint16_t>();
+		for (double value : set) {
+			int exponent;
+			double m = cutDown(value, &exponent);
+			double key = round(m * 1000.0);
+			if (m == 0.0 || abs(key - m * 1000.0) > 1e-6 * key) return false;
+			milli.push_back(key >= 10000.0 ? 1000 : (uint16_t) key);
+		}
+		sort(milli.begin(), milli.end());
+		milli.erase(unique(milli.begin(), milli.end()), milli.end());
+		if (milli.empty() || milli.size() > CUSTOM_SERIES_LIMIT) return false;
+		custom->milli.push_back(milli);
+	}
+
+	// The series are named by their size in the results, so every size can only be used once
+	sort(custom->milli.begin(), custom->milli.end(), [](const vector<uint16_t>& a, const vector<uint16_t>& b) { return a.size() < b.size(); });
+	for (size_t i = 1; i < custom->milli.size(); i++) {
+		if (custom->milli[i].size() == custom->milli[i - 1].size()) return false;
+	}
+
+	size_t count = custom->milli.size();
+	custom->values.resize(count);
+	custom->lookups.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		vector<uint16_t>& milli = custom->milli[i];
+		for (uint16_t m : milli) custom->values[i].push_back(m / 1000.0);
+		milli.push_back(10000);
+	}
+	for (size_t i = 0; i < count; i++) {
+		uint16_t n = (uint16_t) custom->values[i].size();
+		const double* values = custom->values[i].data();
+		const uint8_t* lookup = fillLookup(values, n, custom->lookups[i].data()) ? custom->lookups[i].data() : nullptr;
+		custom->descriptors.push_back({ n, values, custom->milli[i].data(), lookup, nearestSeriesValues<0>, findFixedPairForRatio, rankFixedPairsForRatio });
+	}
+
+	ladder = custom->descriptors;
+	firstComputed = ladder.size();
+	customSeries = move(custom);
+	return true;
+
+}
+
+void ESeriesSolver::Workspace::reserve(size_t capacity) {
+	sorted.reserve(capacity);
+	mantissas.reserve(capacity);
+	index.reserve(capacity);
+	exponents.reserve(capacity);
+	indices.reserve(capacity);
+	errors.reserve(capacity);
+}
+
+int ESeriesSolver::matchRatio(double ratio, double maxError, double* error, double* value1, double* value2) const {
+	
+	if (maxError <= 0.0) return 0;
+	
+	int exponent;
+	double r = cutDown(ratio, &exponent);
+	if (r == 0.0) return 0;
+	
+	call_once(ratiosBuilt, [this]() { buildRatioIndices(); });
+	
+	for (size_t s = 0; s < ladder.size(); s++) {
+		const SeriesDescriptor& series = ladder[s];
+		FIND_E_COUNT(seriesTried, 1);
+		
+		double err;
+		series.matchRatio(ratioIndices[s], r, &err, value1, value2);
+		
+		if (err >= 0 && err <= maxError) {
+			// The values match the ratio transformed to 1.0 - 10.0, move one of the values into the ratio's decade
+			*error = err;
+			if (exponent >= 0) {
+				*value1 = scaleDecade(*value1, exponent);
+			} else {
+				*value2 = scaleDecade(*value2, -exponent);
+			}
+			return series.n;
+		}
+		
+	}
+	
+	return 0;
+	
+}
+
+/*
+* Every series offers its closest pairs, the candidates are placed into the ratio's decade once they are ranked.
+*/
+size_t ESeriesSolver::matchRatios(double ratio, double maxError, span<RatioMatch> best) const {
+
+	if (maxError <= 0.0) return 0;
+
+	int exponent;
+	double r = cutDown(ratio, &exponent);
+	if (r == 0.0) return 0;
+
+	call_once(ratiosBuilt, [this]() { buildRatioIndices(); });
+
+	RatioCandidates candidates = RatioCandidates(best, maxError);
+	FIND_E_COUNT(seriesTried, ladder.size());
+	for (size_t s = 0; s < ladder.size(); s++) {
+		ladder[s].rankRatio(ratioIndices[s], r, candidates);
+	}
+
+	size_t count = candidates.finish();
+	for (size_t i = 0; i < count; i++) {
+		if (exponent >= 0) {
+			best[i].value1 = scaleDecade(best[i].value1, exponent);
+		} else {
+			best[i].value2 = scaleDecade(best[i].value2, -exponent);
+		}
+	}
+	return count;
+
+}
+
+/*
+* Builds the network index of the small series, called once before the first network query.
+*/
+void ESeriesSolver::buildNetworkIndex() const {
+	networkTables.reserve(2 * ladder.size());
+	networkSingles.clear();
+	networkPairs.clear();
+	for (const SeriesDescriptor& series : ladder) {
+		bool indexed = series.n <= NETWORK_SERIES_LIMIT;
+		networkTables.push_back(indexed ? buildNetworkSingles(series.values, series.n) : vector<NetworkHalf>());
+		networkSingles.push_back(networkTables.back());
+		networkTables.push_back(indexed ? buildNetworkPairs(series.values, series.n) : vector<NetworkHalf>());
+		networkPairs.push_back(networkTables.back());
+	}
+}
+
+/*
+* The networks of each series are tried with two, three and then four parts, the first one within the max. error is placed into the ratio's decade.
+*/
+int ESeriesSolver::matchNetwork(double ratio, double maxError, NetworkMatch* network) const {
+
+	if (maxError <= 0.0) return 0;
+
+	int exponent;
+	double r = cutDown(ratio, &exponent);
+	if (r == 0.0) return 0;
+
+	call_once(networkBuilt, [this]() { buildNetworkIndex(); });
+
+	for (size_t s = 0; s < ladder.size() && ladder[s].n <= NETWORK_SERIES_LIMIT; s++) {
+		span<const NetworkHalf> singles = networkSingles[s];
+		span<const NetworkHalf> pairs = networkPairs[s];
+		FIND_E_COUNT(seriesTried, 1);
+
+		double bound = maxError;
+		bool found = findNetworkForRatio(singles, singles, r, &bound, network);
+		if (!found) {
+			found = findNetworkForRatio(pairs, singles, r, &bound, network);
+			found = findNetworkForRatio(singles, pairs, r, &bound, network) || found;
+		}
+		if (!found) found = findNetworkForRatio(pairs, pairs, r, &bound, network);
+		if (!found) continue;
+
+		// Move one of the halves into the decade of the ratio
+		network->series = ladder[s].n;
+		FIND_E_COUNT(powerCalls, 1);
+		int decade = (int) round(log10(ratio * networkValue(network->lower) / networkValue(network->upper)));
+		NetworkHalf& half = decade >= 0 ? network->upper : network->lower;
+		half.value1 = scaleDecade(half.value1, abs(decade));
+		half.value2 = scaleDecade(half.value2, abs(decade));
+		return ladder[s].n;
+	}
+
+	return 0;
+
+}
+
+/*
+* Transforms the values to 1.0 - 10.0, and collects the distinct mantissas in ascending order.
+* The mantissas are rounded to 12 digits, so that values like 0.47 and 4700 end up on the same mantissa despite the inexact scaling.
+* @param values The values to transform
+* @param workspace Returns the distinct mantissas, and for each value the index of its mantissa and its decade
+*/
+void ESeriesSolver::normalizeValues(span<const double> values, Workspace& workspace) {
+
+	workspace.reserve(values.size());
+	workspace.exponents.resize(values.size());
+	workspace.sorted.resize(values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		int exponent;
+		workspace.sorted[i] = { round(cutDown(values[i], &exponent) * 1e12) / 1e12, (uint32_t) i };
+		workspace.exponents[i] = (int16_t) exponent;
+	}
+	sort(workspace.sorted.begin(), workspace.sorted.end());
+
+	workspace.mantissas.clear();
+	workspace.index.resize(values.size());
+	for (const auto& entry : workspace.sorted) {
+		if (workspace.mantissas.empty() || workspace.mantissas.back() != entry.first) {
+			workspace.mantissas.push_back(entry.first);
+		}
+		workspace.index[entry.second] = (uint32_t) workspace.mantissas.size() - 1;
+	}
+
+}
+
+/*
+* Writes the matches of the values for the series whose indices and errors are currently in the workspace.
+*/
+void ESeriesSolver::publishMatches(const SeriesDescriptor& series, span<const double> values, span<ValueMatch> matches, const Workspace& workspace) {
+	for (size_t i = 0; i < values.size(); i++) {
+		uint32_t m = workspace.index[i];
+		double seriesMantissa = seriesValue(series.values, series.n, workspace.indices[m]);
+		matches[i] = { values[i], workspace.mantissas[m], scaleDecade(seriesMantissa, workspace.exponents[i]), workspace.errors[m] };
+	}
+}
+
+/*
+* Matches the normalized mantissas in the workspace against one series, stopping early once an error reaches the bound.
+*/
+double ESeriesSolver::matchSeries(const SeriesDescriptor& series, Workspace& workspace, double bound) {
+	const vector<double>& mantissas = workspace.mantissas;
+	workspace.indices.resize(mantissas.size());
+	workspace.errors.resize(mantissas.size());
+	FIND_E_COUNT(seriesTried, 1);
+	FIND_E_COUNT(candidates, mantissas.size());
+	return series.matchValues(series.values, series.n, series.milli, series.lookup, mantissas.data(), mantissas.size(), workspace.indices.data(), workspace.errors.data(), bound);
+}
+
+/*
+* The values are normalized once, and every series is then only matched against the distinct mantissas.
+* The fixed series are tried one after another. The largest error of the computed series can only shrink from one series to the next,
+* since each one contains all values of the one before, so the first matching computed series is found by bisection.
+*/
+int ESeriesSolver::matchValues(span<const double> values, double maxError, span<ValueMatch> matches, Workspace& workspace, double* largestError) const {
+
+	if (maxError <= 0.0 || matches.size() < values.size()) return 0;
+
+	normalizeValues(values, workspace);
+
+	size_t computed = firstComputed;
+	for (size_t s = 0; s < computed; s++) {
+		*largestError = matchSeries(ladder[s], workspace, maxError);
+		if (*largestError < maxError) {
+			publishMatches(ladder[s], values, matches, workspace);
+			return ladder[s].n;
+		}
+	}
+
+	// The first matching series is in [low, high], high being past the end if none matches
+	size_t low = computed;
+	size_t high = ladder.size();
+	size_t matched = ladder.size();
+	double matchedError = 0.0;
+	bool inWorkspace = false;
+	while (low < high) {
+		size_t s = low + (high - low) / 2;
+		double err = matchSeries(ladder[s], workspace, maxError);
+		inWorkspace = err < maxError;
+		if (inWorkspace) {
+			high = s;
+			matched = s;
+			matchedError = err;
+		} else {
+			low = s + 1;
+			*largestError = err;
+		}
+	}
+	if (matched == ladder.size()) return 0;
+
+	// The workspace holds the matches of the last series tried, which is not necessarily the one found
+	if (!inWorkspace) matchSeries(ladder[matched], workspace, HUGE_VAL);
+	*largestError = matchedError;
+	publishMatches(ladder[matched], values, matches, workspace);
+	return ladder[matched].n;
+
+}
+
+/*
+* Returns the value of a series at a global index, counting all decades, index 0 is the first value of decade 0 (1.0).
+*/
+double globalSeriesValue(const SeriesDescriptor& series, int64_t g) {
+	int64_t decade = g >= 0 ? g / series.n : -((-g + series.n - 1) / series.n);
+	return scaleDecade(series.values[g - decade * series.n], (int) decade);
+}
+
+/*
+* Returns the global index of the first series value not smaller than the value.
+*/
+int64_t globalSeriesIndex(const SeriesDescriptor& series, double v) {
+	int exponent;
+	double m = cutDown(v, &exponent);
+	int64_t position = lower_bound(series.values, series.values + series.n, m) - series.values;
+	return (int64_t) exponent * series.n + position;
+}
+
+/*
+* Covers the values with the fewest values of one series, greedily on the values sorted by size.
+* Each value can use the series values in an interval of global indices, and both ends of the interval grow with the value,
+* so a new part is only needed once a value's interval starts above the upper end of the first interval the current part covers.
+* The part of each group of values is then chosen from the range all their intervals share, with the smallest largest error.
+* @param seriesIndex The series to take the parts from
+* @param values The values to cover
+* @param maxError The maximum error that is acceptable
+* @param limit The search stops once this many parts are needed
+* @param matches Returns the part chosen for each value, or nothing if empty
+* @param workspace The values sorted by size, see minimizeParts
+* @returns The number of parts, or the limit if a value can not be covered or the limit was reached
+*/
+size_t ESeriesSolver::coverValues(const SeriesDescriptor& series, span<const double> values, double maxError, size_t limit, span<ValueMatch> matches, const Workspace& workspace) {
+
+	const auto& sorted = workspace.sorted;
+	auto error = [&](int64_t g, double v) { return abs(globalSeriesValue(series, g) - v) / v; };
+	FIND_E_COUNT(seriesTried, 1);
+
+	// Writes the part of the group of sorted values from first to last, which can use the series values from low to high
+	auto publishGroup = [&](size_t first, size_t last, int64_t low, int64_t high) {
+		double smallest = values[sorted[first].second];
+		double largest = values[sorted[last].second];
+		int64_t center = min(max(globalSeriesIndex(series, sqrt(smallest * largest)), low), high);
+		int64_t part = center;
+		for (int64_t g = max(center - 1, low); g <= min(center + 1, high); g++) {
+			if (max(error(g, smallest), error(g, largest)) < max(error(part, smallest), error(part, largest))) part = g;
+		}
+		double partValue = globalSeriesValue(series, part);
+		for (size_t i = first; i <= last; i++) {
+			double v = values[sorted[i].second];
+			int exponent;
+			matches[sorted[i].second] = { v, cutDown(v, &exponent), partValue, abs(partValue - v) / v };
+		}
+	};
+
+	size_t parts = 0;
+	size_t first = 0;
+	int64_t groupLow = 0;
+	int64_t groupHigh = INT64_MIN;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		double v = values[sorted[i].second];
+		FIND_E_COUNT(candidates, 1);
+
+		// The interval of series values within the error, starting from the value bounds and settled by the actual errors
+		int64_t low = globalSeriesIndex(series, v * (1.0 - maxError));
+		while (error(low, v) >= maxError && globalSeriesValue(series, low) < v) low++;
+		while (error(low - 1, v) < maxError) low--;
+		if (error(low, v) >= maxError) return limit;
+
+		if (groupHigh < low) {
+			if (++parts >= limit) return limit;
+			if (i > 0 && !matches.empty()) publishGroup(first, i - 1, groupLow, groupHigh);
+
+			int64_t high = globalSeriesIndex(series, v * (1.0 + maxError));
+			while (error(high, v) >= maxError) high--;
+			while (error(high + 1, v) < maxError) high++;
+			first = i;
+			groupHigh = high;
+		}
+		groupLow = low;
+	}
+	if (!matches.empty()) publishGroup(first, sorted.size() - 1, groupLow, groupHigh);
+	return parts;
+
+}
+
+/*
+* Every series is covered with a limit of the fewest parts found so far, so the larger series mostly stop early.
+*/
+int ESeriesSolver::minimizeParts(span<const double> values, double maxError, span<ValueMatch> matches, Workspace& workspace, size_t* parts, double* largestError) const {
+
+	if (maxError <= 0.0 || maxError >= 1.0 || values.empty() || matches.size() < values.size()) return 0;
+
+	workspace.reserve(values.size());
+	workspace.sorted.resize(values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		if (!(values[i] > 0.0) || !isfinite(values[i])) return 0;
+		workspace.sorted[i] = { values[i], (uint32_t) i };
+	}
+	sort(workspace.sorted.begin(), workspace.sorted.end());
+
+	size_t best = ladder.size();
+	size_t fewest = values.size() + 1;
+	for (size_t s = 0; s < ladder.size(); s++) {
+		size_t count = coverValues(ladder[s], values, maxError, fewest, span<ValueMatch>(), workspace);
+		if (count < fewest) {
+			fewest = count;
+			best = s;
+		}
+	}
+	if (best == ladder.size()) return 0;
+
+	coverValues(ladder[best], values, maxError, fewest + 1, matches, workspace);
+	*parts = fewest;
+	*largestError = 0.0;
+	for (size_t i = 0; i < values.size(); i++) *largestError = max(*largestError, matches[i].error);
+	return ladder[best].n;
+
+}
+
+/* The largest series searched for ladders, and the most taps a ladder can have */
+static constexpr uint16_t CHAIN_SERIES_LIMIT = 192;
+static constexpr size_t CHAIN_TAPS_LIMIT = 16;
+
+/* The entries of the table of partial sums without completion, a power of two */
+static constexpr size_t CHAIN_STATES = 1 << 14;
+
+/* Resistors below this fraction of the largest one that fits are not tried, they can only move the taps by a fraction of the error */
+static constexpr double CHAIN_SPAN = 1e-2;
+
+/* The partial sums a search of one series can try, so that close taps with many fitting values still resolve quickly */
+static constexpr size_t CHAIN_BUDGET = 1 << 18;
+
+/*
+* The search for a ladder in one series, the resistors are chosen from the bottom of the ladder upwards.
+* Resistor i is the one above tap i, the partial sum of a level is the sum of the resistors below it, the total is the partial sum of level 0.
+* A tap is within the error if its partial sum is within the error of the tap times the total, so the partial sums chosen so far
+* restrict the total to an interval, and the next partial sum has to keep that interval non-empty.
+* Partial sums whose interval turned out to have no completion are kept in a table, other orders of the same resistors reach them again.
+* Each search can try a limited number of partial sums, the optimization returns the best ladder until then, and the plain search gives up on the series.
+*/
+struct ChainSearch {
+
+	const SeriesDescriptor& series;
+	const double* taps;
+	size_t count;
+	double maxError;
+	vector<ESeriesSolver::Workspace::ChainState>& states;
+	uint32_t generation;
+	bool optimize;
+	size_t budget;
+	int64_t chosen[CHAIN_TAPS_LIMIT + 1] = {};
+	int64_t best[CHAIN_TAPS_LIMIT + 1] = {};
+	size_t bestDistinct = 0;
+	double bestError = 0.0;
+	bool found = false;
+
+	ESeriesSolver::Workspace::ChainState& state(size_t level, double sum) {
+		uint64_t key = bit_cast<uint64_t>(sum) ^ ((uint64_t) level * 0x9E3779B97F4A7C15u);
+		key ^= key >> 29;
+		key *= 0xBF58476D1CE4E5B9u;
+		return states[(key >> 32) & (CHAIN_STATES - 1)];
+	}
+
+	// Accepts a complete ladder, the partial sums are taken from the resistors again so that the errors are exact
+	bool finish(size_t distinct) {
+		double sums[CHAIN_TAPS_LIMIT + 1];
+		sums[count] = globalSeriesValue(series, chosen[count]);
+		for (size_t i = count; i-- > 0; ) sums[i] = sums[i + 1] + globalSeriesValue(series, chosen[i]);
+
+		double error = 0.0;
+		for (size_t i = 1; i <= count; i++) error = max(error, abs(sums[i] / sums[0] - taps[i]) / taps[i]);
+		if (error >= maxError) return false;
+
+		if (!found || distinct < bestDistinct || (distinct == bestDistinct && error < bestError)) {
+			copy(chosen, chosen + count + 1, best);
+			bestDistinct = distinct;
+			bestError = error;
+			found = true;
+		}
+		return true;
+	}
+
+	// Tries one resistor above the partial sum of the level
+	bool place(size_t level, int64_t g, double sum, double low, double high, double error, size_t distinct) {
+		double next = sum + globalSeriesValue(series, g);
+		if (level > 1) {
+			low = max(low, next / (taps[level - 1] * (1.0 + error)));
+			high = min(high, next / (taps[level - 1] * (1.0 - error)));
+			if (low > high) return false;
+		} else if (next < low || next > high) {
+			return false;
+		}
+
+		bool shared = find(chosen + level, chosen + count + 1, g) != chosen + count + 1;
+		size_t d = distinct + (shared ? 0 : 1);
+		if (optimize && found && d > bestDistinct) return false;
+
+		chosen[level - 1] = g;
+		return level == 1 ? finish(d) : extend(level - 1, next, low, high, d);
+	}
+
+	/*
+	* Chooses the resistors above the partial sum of a level, for a total within [low, high].
+	* The values already in the ladder are tried first, then the others that keep the total interval non-empty, outwards from the ideal one.
+	* When optimizing, ladders with more distinct values than the best are cut off, and with as many the error of the best is the bound.
+	* @returns true if a ladder within the max. error was found below this level
+	*/
+	bool extend(size_t level, double sum, double low, double high, size_t distinct) {
+
+		ESeriesSolver::Workspace::ChainState& known = state(level, sum);
+		bool seen = known.generation == generation && known.level == level && known.sum == sum;
+		if (seen && low >= known.low && high <= known.high) return false;
+		if (budget == 0) return false;
+		budget--;
+		FIND_E_COUNT(candidates, 1);
+
+		double error = optimize && found && distinct == bestDistinct ? bestError : maxError;
+		double lower = level > 1 ? taps[level - 1] * (1.0 - error) * low : low;
+		double upper = level > 1 ? taps[level - 1] * (1.0 + error) * high : high;
+		if (upper <= sum) return false;
+
+		bool any = false;
+		for (size_t i = level; i <= count; i++) {
+			if (find(chosen + level, chosen + i, chosen[i]) != chosen + i) continue;
+			if (place(level, chosen[i], sum, low, high, error, distinct)) {
+				any = true;
+				if (!optimize) return true;
+			}
+		}
+
+		double smallest = max(lower - sum, (upper - sum) * CHAIN_SPAN);
+		double largest = upper - sum;
+		double ideal = min(max(taps[level - 1] * sqrt(low * high) - sum, smallest), largest);
+		int64_t up = globalSeriesIndex(series, ideal);
+		int64_t down = up - 1;
+		while (true) {
+			double above = globalSeriesValue(series, up);
+			double below = globalSeriesValue(series, down);
+			bool useUp = above <= largest && (below < smallest || above / ideal < ideal / below);
+			if (!useUp && below < smallest) break;
+			int64_t g = useUp ? up++ : down--;
+
+			if (find(chosen + level, chosen + count + 1, g) != chosen + count + 1) continue;
+			if (place(level, g, sum, low, high, error, distinct)) {
+				any = true;
+				if (!optimize) return true;
+			}
+			if (optimize && found && distinct == bestDistinct) error = bestError;
+		}
+
+		// Only a complete plain search proves that there is no completion, the bounds of the optimization cut off valid ladders as well
+		if (!any && !optimize && budget > 0) {
+			seen = known.generation == generation && known.level == level && known.sum == sum;
+			if (seen && low <= known.high && high >= known.low) {
+				known.low = min(known.low, low);
+				known.high = max(known.high, high);
+			} else {
+				known = { sum, low, high, (uint32_t) level, generation };
+			}
+		}
+		return any;
+
+	}
+
+	// Tries every value of the first decade as the bottom resistor
+	bool search() {
+		for (int64_t g = 0; g < series.n; g++) {
+			double value = globalSeriesValue(series, g);
+			double error = optimize && found && bestDistinct == 1 ? bestError : maxError;
+			chosen[count] = g;
+			if (extend(count, value, value / (taps[count] * (1.0 + error)), value / (taps[count] * (1.0 - error)), 1) && !optimize) return true;
+		}
+		return found;
+	}
+
+};
+
+/*
+* Each series first gets a plain search, which stops at the first ladder, the first series with one is then searched for the best ladder.
+* The table of partial sums without completion from the plain search is kept for that.
+*/
+int ESeriesSolver::matchChain(span<const double> taps, double maxError, span<double> resistors, span<ValueMatch> matches, Workspace& workspace, size_t* distinct, double* largestError) const {
+
+	size_t count = taps.size();
+	if (maxError <= 0.0 || maxError >= 1.0 || count == 0 || count > CHAIN_TAPS_LIMIT) return 0;
+	if (resistors.size() < count + 1 || matches.size() < count) return 0;
+
+	// The taps from the top of the ladder down, with the total as tap 0
+	workspace.sorted.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		if (!(taps[i] > 0.0 && taps[i] < 1.0)) return 0;
+		workspace.sorted[i] = { taps[i], (uint32_t) i };
+	}
+	sort(workspace.sorted.begin(), workspace.sorted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	double ordered[CHAIN_TAPS_LIMIT + 1];
+	ordered[0] = 1.0;
+	for (size_t i = 0; i < count; i++) {
+		ordered[i + 1] = workspace.sorted[i].first;
+		if (ordered[i + 1] == ordered[i]) return 0;
+	}
+
+	workspace.chainStates.resize(CHAIN_STATES);
+	for (size_t s = 0; s < ladder.size() && ladder[s].n <= CHAIN_SERIES_LIMIT; s++) {
+		FIND_E_COUNT(seriesTried, 1);
+		if (++workspace.chainGeneration == 0) {
+			fill(workspace.chainStates.begin(), workspace.chainStates.end(), Workspace::ChainState());
+			workspace.chainGeneration = 1;
+		}
+
+		ChainSearch search = { ladder[s], ordered, count, maxError, workspace.chainStates, workspace.chainGeneration, false, CHAIN_BUDGET };
+		if (!search.search()) continue;
+		search.optimize = true;
+		search.budget = CHAIN_BUDGET;
+		search.search();
+
+		double sum = 0.0;
+		double sums[CHAIN_TAPS_LIMIT + 1];
+		for (size_t i = count + 1; i-- > 0; ) {
+			resistors[i] = globalSeriesValue(ladder[s], search.best[i]);
+			sum += resistors[i];
+			sums[i] = sum;
+		}
+		for (size_t i = 0; i < count; i++) {
+			int exponent;
+			double ratio = sums[i + 1] / sum;
+			uint32_t tap = workspace.sorted[i].second;
+			matches[tap] = { taps[tap], cutDown(taps[tap], &exponent), ratio, abs(ratio - taps[tap]) / taps[tap] };
+		}
+		*distinct = search.bestDistinct;
+		*largestError = search.bestError;
+		return ladder[s].n;
+	}
+
+	return 0;
+
+}
+
+size_t ESeriesSolver::seriesCount() const {
+	return ladder.size();
+}
+
+span<const double> ESeriesSolver::seriesValues(size_t seriesIndex) const {
+	if (seriesIndex >= ladder.size()) return span<const double>();
+	return span<const double>(ladder[seriesIndex].values, ladder[seriesIndex].n);
+}
+
+void ESeriesSolver::errorProfile(span<const double> values, span<SeriesError> profile, Workspace& workspace) const {
+
+	normalizeValues(values, workspace);
+
+	for (size_t s = 0; s < ladder.size() && s < profile.size(); s++) {
+		profile[s] = { ladder[s].n, matchSeries(ladder[s], workspace, HUGE_VAL) };
+	}
+
+}
+
+int ESeriesSolver::seriesForError(span<const SeriesError> profile, double maxError) {
+
+	if (maxError <= 0.0) return -1;
+
+	for (size_t s = 0; s < profile.size(); s++) {
+		if (profile[s].largestError < maxError) return (int) s;
+	}
+	return -1;
+
+}
+
+int ESeriesSolver::matchValuesInSeries(span<const double> values, size_t seriesIndex, span<ValueMatch> matches, Workspace& workspace, double* largestError) const {
+
+	if (seriesIndex >= ladder.size() || matches.size() < values.size()) return 0;
+
+	normalizeValues(values, workspace);
+	*largestError = matchSeries(ladder[seriesIndex], workspace, HUGE_VAL);
+	publishMatches(ladder[seriesIndex], values, matches, workspace);
+	return ladder[seriesIndex].n;
+
+}
+
+StockIndex::StockIndex(span<const double> values) {
+
+	sorted.reserve(values.size());
+	for (double v : values) {
+		if (v > 0.0 && isfinite(v)) sorted.push_back(v);
+	}
+	sort(sorted.begin(), sorted.end());
+	sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+
+	// Position 0 is unused, the children of position k are at 2k and 2k + 1
+	tree.resize(sorted.size() + 1);
+	rank.resize(sorted.size() + 1);
+	fillTree(0, 1);
+
+}
+
+/*
+* Fills the subtree at position k with the sorted values from index i onwards, in order, and returns the index of the next value.
+*/
+size_t StockIndex::fillTree(size_t i, size_t k) {
+	if (k < tree.size()) {
+		i = fillTree(i, 2 * k);
+		tree[k] = sorted[i];
+		rank[k] = (uint32_t) i++;
+		i = fillTree(i, 2 * k + 1);
+	}
+	return i;
+}
+
+/*
+* The search descends the tree without branches, fetching the descendants three levels down ahead of time.
+* The position it ends on encodes the path taken, the first value not smaller than the requested one is where it last went left.
+*/
+double StockIndex::nearest(double value, double* error) const {
+
+	*error = 0.0;
+	if (sorted.empty() || !(value > 0.0) || !isfinite(value)) return 0.0;
+
+	FIND_E_COUNT(indexSearches, 1);
+	size_t k = 1;
+	while (k < tree.size()) {
+		if ((k << 3) < tree.size()) FIND_E_PREFETCH(tree.data() + (k << 3));
+		k = 2 * k + (tree[k] < value);
+	}
+	k >>= countr_one(k) + 1;
+
+	size_t upper = k == 0 ? sorted.size() : rank[k];
+	double best = upper == sorted.size() ? sorted.back() : sorted[upper];
+	if (upper > 0 && value - sorted[upper - 1] < abs(best - value)) best = sorted[upper - 1];
+
+	*error = abs(best - value) / value;
+	return best;
+
+}
+
+bool StockIndex::matchValues(span<const double> values, double maxError, span<ValueMatch> matches, double* largestError) const {
+
+	*largestError = 0.0;
+	if (maxError <= 0.0 || sorted.empty() || matches.size() < values.size()) return false;
+
+	bool valid = true;
+	for (size_t i = 0; i < values.size(); i++) {
+		int exponent;
+		double err;
+		double mantissa = cutDown(values[i], &exponent);
+		double match = nearest(values[i], &err);
+		valid = valid && mantissa != 0.0;
+		matches[i] = { values[i], mantissa, match, err };
+		*largestError = max(*largestError, err);
+	}
+	return valid && *largestError < maxError;
+
+}
+
+/*
+* Every value in stock is tried as the second value, against the values next to the matching first value.
+* The first value grows with the second one, so both are walked through the sorted values together instead of searching each time.
+*/
+bool StockIndex::matchRatio(double ratio, double maxError, double* error, double* value1, double* value2) const {
+
+	if (maxError <= 0.0 || sorted.empty() || !(ratio > 0.0) || !isfinite(ratio)) return false;
+
+	*error = -1.0;
+	size_t below = 0;
+	for (double v2 : sorted) {
+		double target = ratio * v2;
+		while (below + 1 < sorted.size() && sorted[below + 1] <= target) below++;
+
+		for (size_t i = below; i <= below + 1 && i < sorted.size(); i++) {
+			FIND_E_COUNT(candidates, 1);
+			double err = abs(sorted[i] / v2 - ratio) / ratio;
+			if (err < *error || *error < 0) {
+				*error = err;
+				*value1 = sorted[i];
+				*value2 = v2;
+			}
+		}
+	}
+	return *error <= maxError;
+
+}
+
+/*
+* A file mapped read only into memory, the pages are shared with all other processes mapping the same file.
+*/
+class MappedFile {
+
+public:
+	MappedFile(const char* path) : data(nullptr), size(0) {
+#if defined(_WIN32)
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		mapping = nullptr;
+		LARGE_INTEGER length;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length) || length.QuadPart == 0) return;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) return;
+		data = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data != nullptr) size = (size_t) length.QuadPart;
+#else
+		int file = open(path, O_RDONLY);
+		if (file < 0) return;
+		struct stat status;
+		if (fstat(file, &status) == 0 && status.st_size > 0) {
+			void* view = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_SHARED, file, 0);
+			if (view != MAP_FAILED) {
+				data = (const uint8_t*) view;
+				size = (size_t) status.st_size;
+			}
+		}
+		close(file);
+#endif
+	}
+
+	~MappedFile() {
+#if defined(_WIN32)
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data != nullptr) munmap((void*) data, size);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data;
+	size_t size;
+
+private:
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+};
+
+/* Identifies index files, the version changes whenever the layout of the file or the tables changes */
+static constexpr char INDEX_MAGIC[8] = { 'F', 'I', 'N', 'D', 'E', 'I', 'D', 'X' };
+static constexpr uint32_t INDEX_VERSION = 2;
+
+/* All tables in the index file start at a multiple of this */
+static constexpr size_t INDEX_ALIGNMENT = 64;
+
+/*
+* The start of an index file, followed by one IndexSeries for every series, and then the tables.
+* The sizes of the table entries and a known value are stored, so that files from builds with a different layout or byte order are rejected.
+*/
+struct IndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t seriesCount;
+	uint32_t ratioEntrySize;
+	uint32_t networkHalfSize;
+	uint64_t fileSize;
+	double check;
+	uint8_t reserved[24];
+};
+
+/*
+* The location of the tables of one series in the index file, as offsets from the start of the file and numbers of entries.
+*/
+struct IndexSeries {
+	uint16_t series;
+	uint16_t reserved[3];
+	uint64_t ratioOffset;
+	uint64_t ratioCount;
+	uint64_t singlesOffset;
+	uint64_t singlesCount;
+	uint64_t pairsOffset;
+	uint64_t pairsCount;
+	uint64_t reserved2;
+};
+
+static_assert(sizeof(IndexHeader) == INDEX_ALIGNMENT && sizeof(IndexSeries) == INDEX_ALIGNMENT, "the index file entries have to be one alignment unit");
+
+/*
+* Returns the offset rounded up to the next multiple of the index alignment.
+*/
+constexpr uint64_t alignIndex(uint64_t offset) {
+	return (offset + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+}
+
+/*
+* Checks that a table lies within the file and is aligned, and returns it.
+*/
+template<typename T>
+bool mappedTable(const MappedFile& file, uint64_t offset, uint64_t count, span<const T>* table) {
+	if (offset % INDEX_ALIGNMENT != 0 || offset > file.size || count > (file.size - offset) / sizeof(T)) return false;
+	*table = span<const T>((const T*) (file.data + offset), (size_t) count);
+	return true;
+}
+
+bool ESeriesSolver::loadIndex(const char* path) {
+
+	if (customSeries != nullptr) return false;
+
+	unique_ptr<MappedFile> file = make_unique<MappedFile>(path);
+	if (file->data == nullptr || file->size < sizeof(IndexHeader)) return false;
+
+	const IndexHeader* header = (const IndexHeader*) file->data;
+	if (memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header->version != INDEX_VERSION) return false;
+	if (header->seriesCount != size(SERIES) || header->ratioEntrySize != sizeof(RatioEntry) || header->networkHalfSize != sizeof(NetworkHalf)) return false;
+	if (header->fileSize != file->size || header->check != 1.0) return false;
+	if (file->size < sizeof(IndexHeader) + size(SERIES) * sizeof(IndexSeries)) return false;
+
+	// Validate everything before switching over, so that a broken file leaves the tables to be generated
+	const IndexSeries* entries = (const IndexSeries*) (file->data + sizeof(IndexHeader));
+	vector<span<const RatioEntry>> ratios = vector<span<const RatioEntry>>(size(SERIES));
+	vector<span<const NetworkHalf>> singles = vector<span<const NetworkHalf>>(size(SERIES));
+	vector<span<const NetworkHalf>> pairs = vector<span<const NetworkHalf>>(size(SERIES));
+	for (size_t s = 0; s < size(SERIES); s++) {
+		const IndexSeries& entry = entries[s];
+		if (entry.series != SERIES[s].n) return false;
+		if (!mappedTable(*file, entry.ratioOffset, entry.ratioCount, &ratios[s])) return false;
+		if (!mappedTable(*file, entry.singlesOffset, entry.singlesCount, &singles[s])) return false;
+		if (!mappedTable(*file, entry.pairsOffset, entry.pairsCount, &pairs[s])) return false;
+	}
+
+	call_once(ratiosBuilt, [&]() {
+		ratioIndices = ratios;
+	});
+	call_once(networkBuilt, [&]() {
+		networkSingles = singles;
+		networkPairs = pairs;
+	});
+	indexFile = move(file);
+	return true;
+
+}
+
+void ESeriesSolver::prepare() const {
+	call_once(ratiosBuilt, [this]() { buildRatioIndices(); });
+	call_once(networkBuilt, [this]() { buildNetworkIndex(); });
+}
+
+/*
+* The indices are generated first if they were not used before, so that the file holds every table.
+*/
+bool ESeriesSolver::writeIndex(const char* path) const {
+
+	if (customSeries != nullptr) return false;
+	prepare();
+
+	// Lay out the tables behind the header and the series entries
+	IndexHeader header = IndexHeader();
+	memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.seriesCount = (uint32_t) size(SERIES);
+	header.ratioEntrySize = sizeof(RatioEntry);
+	header.networkHalfSize = sizeof(NetworkHalf);
+	header.check = 1.0;
+
+	vector<IndexSeries> entries = vector<IndexSeries>(size(SERIES));
+	uint64_t offset = alignIndex(sizeof(IndexHeader) + entries.size() * sizeof(IndexSeries));
+	for (size_t s = 0; s < size(SERIES); s++) {
+		IndexSeries& entry = entries[s];
+		entry.series = SERIES[s].n;
+		entry.ratioOffset = offset;
+		entry.ratioCount = ratioIndices[s].size();
+		offset = alignIndex(offset + entry.ratioCount * sizeof(RatioEntry));
+		entry.singlesOffset = offset;
+		entry.singlesCount = networkSingles[s].size();
+		offset = alignIndex(offset + entry.singlesCount * sizeof(NetworkHalf));
+		entry.pairsOffset = offset;
+		entry.pairsCount = networkPairs[s].size();
+		offset = alignIndex(offset + entry.pairsCount * sizeof(NetworkHalf));
+	}
+	header.fileSize = offset;
+
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) return false;
+
+	static const uint8_t padding[INDEX_ALIGNMENT] = {};
+	uint64_t written = 0;
+	auto write = [&](const void* data, size_t length) {
+		if (length > 0 && fwrite(data, 1, length, file) == length) written += length;
+	};
+	auto pad = [&]() {
+		write(padding, (size_t) (alignIndex(written) - written));
+	};
+
+	write(&header, sizeof(header));
+	write(entries.data(), entries.size() * sizeof(IndexSeries));
+	pad();
+	for (size_t s = 0; s < size(SERIES); s++) {
+		write(ratioIndices[s].data(), ratioIndices[s].size() * sizeof(RatioEntry));
+		pad();
+		write(networkSingles[s].data(), networkSingles[s].size() * sizeof(NetworkHalf));
+		pad();
+		write(networkPairs[s].data(), networkPairs[s].size() * sizeof(NetworkHalf));
+		pad();
+	}
+
+	bool complete = fclose(file) == 0 && written == header.fileSize;
+	if (!complete) remove(path);
+	return complete;
+
+}
+
+double seriesTolerance(uint16_t series) {
+	if (series <= 6) return 0.2;
+	if (series <= 12) return 0.1;
+	if (series <= 24) return 0.05;
+	if (series <= 48) return 0.02;
+	if (series <= 96) return 0.01;
+	if (series <= 192) return 0.005;
+	return 0.001;
+}
+
+/* The resolution of the yield histogram */
+static const size_t YIELD_BINS = 4096;
+
+/* The samples simulated together, so that the compiler can vectorize the generator over them */
+static const size_t YIELD_LANES = 8;
+
+/*
+* The largest error is reached with both values and both tempcos at opposite ends of their spread, at either end of the temperature range.
+*/
+YieldAnalysis::YieldAnalysis(const YieldModel& model) : model(model), bins(YIELD_BINS), sampled(0), inside(0), largest(0.0) {
+	double drift = model.tempco * model.temperature;
+	double spread = (1.0 + model.tolerance) * (1.0 + drift) / ((1.0 - model.tolerance) * (1.0 - drift));
+	double nominal = model.value1 / model.value2;
+	range = max(abs(nominal * spread - model.ratio), abs(nominal / spread - model.ratio)) / model.ratio;
+	if (!(range > 0.0) || !isfinite(range)) range = 1.0;
+}
+
+/*
+* Philox 4x32-10 for the eight counters [base, base + 8), the second word of a counter holds the upper half of its number, the other two are zero.
+* AVX2 and SSE2 keep one counter per 64 bit lane, the multiplication only reads the lower half of a lane, so the upper halves are never cleared.
+* NEON keeps four counters per vector, and separates the halves of the products again.
+* @param base The first counter
+* @param seed The key
+* @param words Returns the four words for each counter
+*/
+static void philoxBlock(uint64_t base, uint64_t seed, uint32_t (&words)[4][YIELD_LANES]) {
+
+#if defined(FIND_E_AVX2)
+
+	const __m256i m0 = _mm256_set1_epi64x(0xD2511F53), m1 = _mm256_set1_epi64x(0xCD9E8D57);
+	const __m256i w0 = _mm256_set1_epi64x(0x9E3779B9), w1 = _mm256_set1_epi64x(0xBB67AE85);
+	__m256i k0 = _mm256_set1_epi64x((uint32_t) seed), k1 = _mm256_set1_epi64x(seed >> 32);
+
+	__m256i c[2][4];
+	for (int v = 0; v < 2; v++) {
+		c[v][0] = _mm256_add_epi64(_mm256_set1_epi64x(base), _mm256_set_epi64x(4 * v + 3, 4 * v + 2, 4 * v + 1, 4 * v));
+		c[v][1] = _mm256_srli_epi64(c[v][0], 32);
+		c[v][2] = _mm256_setzero_si256();
+		c[v][3] = _mm256_setzero_si256();
+	}
+	for (int round = 0; round < 10; round++) {
+		for (int v = 0; v < 2; v++) {
+			__m256i p0 = _mm256_mul_epu32(c[v][0], m0);
+			__m256i p1 = _mm256_mul_epu32(c[v][2], m1);
+			c[v][0] = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c[v][1]), k0);
+			c[v][2] = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c[v][3]), k1);
+			c[v][1] = p1;
+			c[v][3] = p0;
+		}
+		k0 = _mm256_add_epi64(k0, w0);
+		k1 = _mm256_add_epi64(k1, w1);
+	}
+
+	// Gather the lower halves of the lanes
+	const __m256i pick = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+	for (int j = 0; j < 4; j++) {
+		for (int v = 0; v < 2; v++) {
+			_mm_storeu_si128((__m128i*) (words[j] + 4 * v), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(c[v][j], pick)));
+		}
+	}
+
+#elif defined(FIND_E_SSE2)
+
+	const __m128i m0 = _mm_set1_epi64x(0xD2511F53), m1 = _mm_set1_epi64x(0xCD9E8D57);
+	const __m128i w0 = _mm_set1_epi64x(0x9E3779B9), w1 = _mm_set1_epi64x(0xBB67AE85);
+	__m128i k0 = _mm_set1_epi64x((uint32_t) seed), k1 = _mm_set1_epi64x(seed >> 32);
+
+	__m128i c[4][4];
+	for (int v = 0; v < 4; v++) {
+		c[v][0] = _mm_add_epi64(_mm_set1_epi64x(base), _mm_set_epi64x(2 * v + 1, 2 * v));
+		c[v][1] = _mm_srli_epi64(c[v][0], 32);
+		c[v][2] = _mm_setzero_si128();
+		c[v][3] = _mm_setzero_si128();
+	}
+	for (int round = 0; round < 10; round++) {
+		for (int v = 0; v < 4; v++) {
+			__m128i p0 = _mm_mul_epu32(c[v][0], m0);
+			__m128i p1 = _mm_mul_epu32(c[v][2], m1);
+			c[v][0] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p1, 32), c[v][1]), k0);
+			c[v][2] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p0, 32), c[v][3]), k1);
+			c[v][1] = p1;
+			c[v][3] = p0;
+		}
+		k0 = _mm_add_epi64(k0, w0);
+		k1 = _mm_add_epi64(k1, w1);
+	}
+
+	// Gather the lower halves of the lanes, two vectors at a time
+	for (int j = 0; j < 4; j++) {
+		for (int v = 0; v < 4; v += 2) {
+			__m128i low = _mm_shuffle_epi32(c[v][j], _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i high = _mm_shuffle_epi32(c[v + 1][j], _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i*) (words[j] + 2 * v), _mm_unpacklo_epi64(low, high));
+		}
+	}
+
+#elif defined(FIND_E_NEON)
+
+	const uint32x4_t m0 = vdupq_n_u32(0xD2511F53), m1 = vdupq_n_u32(0xCD9E8D57);
+	uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+
+	uint32x4_t c[2][4];
+	for (int v = 0; v < 2; v++) {
+		uint32_t counters[4], upper[4];
+		for (int l = 0; l < 4; l++) {
+			counters[l] = (uint32_t) (base + 4 * v + l);
+			upper[l] = (uint32_t) ((base + 4 * v + l) >> 32);
+		}
+		c[v][0] = vld1q_u32(counters);
+		c[v][1] = vld1q_u32(upper);
+		c[v][2] = vdupq_n_u32(0);
+		c[v][3] = vdupq_n_u32(0);
+	}
+	for (int round = 0; round < 10; round++) {
+		uint32x4_t key0 = vdupq_n_u32(k0), key1 = vdupq_n_u32(k1);
+		for (int v = 0; v < 2; v++) {
+			uint32x4_t p0low = vreinterpretq_u32_u64(vmull_u32(vget_low_u32(c[v][0]), vget_low_u32(m0)));
+			uint32x4_t p0high = vreinterpretq_u32_u64(vmull_high_u32(c[v][0], m0));
+			uint32x4_t p1low = vreinterpretq_u32_u64(vmull_u32(vget_low_u32(c[v][2]), vget_low_u32(m1)));
+			uint32x4_t p1high = vreinterpretq_u32_u64(vmull_high_u32(c[v][2], m1));
+			c[v][0] = veorq_u32(veorq_u32(vuzp2q_u32(p1low, p1high), c[v][1]), key0);
+			c[v][2] = veorq_u32(veorq_u32(vuzp2q_u32(p0low, p0high), c[v][3]), key1);
+			c[v][1] = vuzp1q_u32(p1low, p1high);
+			c[v][3] = vuzp1q_u32(p0low, p0high);
+		}
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+
+	for (int j = 0; j < 4; j++) {
+		for (int v = 0; v < 2; v++) vst1q_u32(words[j] + 4 * v, c[v][j]);
+	}
+
+#else
+
+	uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+	for (size_t l = 0; l < YIELD_LANES; l++) {
+		words[0][l] = (uint32_t) (base + l);
+		words[1][l] = (uint32_t) ((base + l) >> 32);
+		words[2][l] = 0;
+		words[3][l] = 0;
+	}
+	for (int round = 0; round < 10; round++) {
+		for (size_t l = 0; l < YIELD_LANES; l++) {
+			uint64_t p0 = (uint64_t) 0xD2511F53u * words[0][l];
+			uint64_t p1 = (uint64_t) 0xCD9E8D57u * words[2][l];
+			words[0][l] = (uint32_t) (p1 >> 32) ^ words[1][l] ^ k0;
+			words[2][l] = (uint32_t) (p0 >> 32) ^ words[3][l] ^ k1;
+			words[1][l] = (uint32_t) p1;
+			words[3][l] = (uint32_t) p0;
+		}
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+
+#endif
+
+}
+
+/*
+* The four words of a counter give the spread of both values and the temperature, both tempcos share the remaining word at half the resolution.
+*/
+void YieldAnalysis::simulate(uint64_t first, uint64_t count) {
+
+	const double scale = YIELD_BINS / range;
+	const double unit = 1.0 / 2147483648.0;
+	const double tolerance = model.tolerance * unit;
+	const double temperature = model.temperature * unit;
+	const double tempco = model.tempco / 32768.0;
+	const double ratio = model.ratio;
+	const double inverse = 1.0 / model.ratio;
+	const double nominal = model.value1 / model.value2;
+
+	for (uint64_t base = first; base < first + count; base += YIELD_LANES) {
+		uint32_t c[4][YIELD_LANES];
+		philoxBlock(base, model.seed, c);
+
+		double errors[YIELD_LANES];
+		uint32_t bin[YIELD_LANES];
+
+#if defined(FIND_E_AVX2)
+
+		// The same operations in the same order as below, four samples at once
+		for (size_t l = 0; l < YIELD_LANES; l += 4) {
+			__m128i drifts = _mm_loadu_si128((const __m128i*) (c[2] + l));
+			__m256d t = _mm256_mul_pd(_mm256_set1_pd(temperature), _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (c[3] + l))));
+			__m256d tc1 = _mm256_mul_pd(_mm256_set1_pd(tempco), _mm256_cvtepi32_pd(_mm_srai_epi32(drifts, 16)));
+			__m256d tc2 = _mm256_mul_pd(_mm256_set1_pd(tempco), _mm256_cvtepi32_pd(_mm_srai_epi32(_mm_slli_epi32(drifts, 16), 16)));
+			__m256d d1 = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(tc1, t));
+			__m256d d2 = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(tc2, t));
+			__m256d s1 = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(tolerance), _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (c[0] + l)))));
+			__m256d s2 = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(tolerance), _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (c[1] + l)))));
+			__m256d r = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(nominal), s1), d1), _mm256_mul_pd(s2, d2));
+			__m256d error = _mm256_mul_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), _mm256_sub_pd(r, _mm256_set1_pd(ratio))), _mm256_set1_pd(inverse));
+			_mm256_storeu_pd(errors + l, error);
+			__m256d position = _mm256_min_pd(_mm256_mul_pd(error, _mm256_set1_pd(scale)), _mm256_set1_pd((double) (YIELD_BINS - 1)));
+			_mm_storeu_si128((__m128i*) (bin + l), _mm256_cvttpd_epi32(position));
+		}
+
+#else
+
+		for (size_t l = 0; l < YIELD_LANES; l++) {
+			double t = temperature * (int32_t) c[3][l];
+			double d1 = 1.0 + tempco * (int16_t) (c[2][l] >> 16) * t;
+			double d2 = 1.0 + tempco * (int16_t) c[2][l] * t;
+			double r = nominal * (1.0 + tolerance * (int32_t) c[0][l]) * d1 / ((1.0 + tolerance * (int32_t) c[1][l]) * d2);
+			errors[l] = abs(r - ratio) * inverse;
+			bin[l] = (uint32_t) min(errors[l] * scale, (double) (YIELD_BINS - 1));
+		}
+
+#endif
+
+		size_t lanes = (size_t) min<uint64_t>(YIELD_LANES, first + count - base);
+		for (size_t l = 0; l < lanes; l++) {
+			bins[bin[l]]++;
+			inside += errors[l] <= model.maxError;
+			largest = max(largest, errors[l]);
+		}
+	}
+	sampled += count;
+
+}
+
+void YieldAnalysis::merge(const YieldAnalysis& other) {
+	for (size_t i = 0; i < YIELD_BINS; i++) bins[i] += other.bins[i];
+	sampled += other.sampled;
+	inside += other.inside;
+	largest = max(largest, other.largest);
+}
+
+/*
+* The samples are assumed to be spread evenly within the bin the percentile falls into.
+*/
+double YieldAnalysis::percentile(double fraction) const {
+	if (sampled == 0) return 0.0;
+	double target = fraction * (double) sampled;
+	uint64_t below = 0;
+	for (size_t i = 0; i < YIELD_BINS; i++) {
+		if ((double) (below + bins[i]) >= target && bins[i] > 0) {
+			double error = (i + (target - below) / bins[i]) * range / YIELD_BINS;
+			return min(error, largest);
+		}
+		below += bins[i];
+	}
+	return largest;
+}
@@ -0,0 +1,481 @@
+﻿/*
+* Library interface of the find E tool, for finding the E-series matching a set of component values or a ratio of two values.
+* The solver is constructed once, and can then be queried from any number of threads at the same time.
+* 
+* Copyright 2024 M_Marvin (Discord, GitHub)
+* 
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*/
+
+#pragma once
+
+#include <vector>
+#include <span>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* The result for one requested value, the series value is moved to the decade of the original value.
+*/
+struct ValueMatch {
+	double original;
+	double mantissa;
+	double seriesValue;
+	double error;
+};
+
+/*
+* An entry of the ratio index, describing a ratio that can be made from two values of a series.
+*/
+struct RatioEntry {
+	double ratio;
+	double value1;
+	double value2;
+	uint16_t series;
+};
+
+/*
+* One pair of values for a ratio, the ranked ratio search returns a list of these.
+*/
+struct RatioMatch {
+	double error;
+	double value1;
+	double value2;
+	uint16_t series;
+};
+
+/*
+* How the values of one half of a resistor network are connected.
+*/
+enum NetworkBranch : uint8_t {
+	BRANCH_SINGLE,
+	BRANCH_SERIES,
+	BRANCH_PARALLEL
+};
+
+/*
+* One half of a resistor network, a single value or two values in series or parallel.
+* The network index holds these with the mantissa of their combined value, single values only use the first value.
+*/
+struct NetworkHalf {
+	double mantissa;
+	double value1;
+	double value2;
+	NetworkBranch branch;
+};
+
+/*
+* A resistor network for a ratio, the ratio is the combined value of the upper half divided by that of the lower half.
+*/
+struct NetworkMatch {
+	double error;
+	uint16_t series;
+	NetworkHalf upper;
+	NetworkHalf lower;
+};
+
+/*
+* Returns the combined value of one half of a resistor network.
+*/
+double networkValue(const NetworkHalf& half);
+
+/*
+* The largest error of a set of values in one E-series, an error profile holds one of these for every series.
+*/
+struct SeriesError {
+	uint16_t series;
+	double largestError;
+};
+
+/*
+* Transforms a value passed into a value in the range 1.0 - 10.0, and returns the decade it was taken from
+* Example: 0.00456 -> 4.56 (-3)	12300 -> 1.23 (4)
+* @param d The value to transform
+* @param exponent Returns the decade of the value, so that d = mantissa * 10^exponent
+* @returns The mantissa of the value, or zero if the value is zero, negative or not finite
+*/
+double cutDown(double d, int* exponent);
+
+/*
+* Multiplies a value by 10^e, the values stay exact as long as the power of ten is.
+*/
+double scaleDecade(double d, int e);
+
+/*
+* Counters of the work done by the solver, only counted when built with FIND_E_STATS.
+* Each thread counts on its own, the difference before and after a query is the work of that query.
+*/
+struct SolverStats {
+	// Series searched by the queries, including those that did not match
+	uint64_t seriesTried;
+	// Values, pairs, network halves and ladder nodes compared against the request
+	uint64_t candidates;
+	// Powers and logarithms of ten computed, mostly for moving values between decades
+	uint64_t powerCalls;
+	// Values found through the nearest value lookup tables of the fixed series
+	uint64_t lookupHits;
+	// Binary searches in the series values and in the ratio, network and stock indices
+	uint64_t indexSearches;
+};
+
+/*
+* Returns the counters of the calling thread, they stay zero if the solver was built without FIND_E_STATS.
+*/
+const SolverStats& solverStats();
+
+class MappedFile;
+struct ChainSearch;
+struct SeriesDescriptor;
+struct CustomSeries;
+
+/*
+* Finds the E-series matching a set of values or a ratio, the series are tried from E3 upwards and the first one within the max. error is returned.
+* The ratio and network indices are generated by the first query that needs them, that query allocates them and takes milliseconds longer.
+* After prepare, or once an index file written with writeIndex before is mapped, the queries do not allocate any memory. They can always run concurrently.
+* The E-series can also be replaced by custom series, which are searched the same way as the fixed E-series.
+*/
+class ESeriesSolver {
+
+public:
+	/*
+	* Scratch memory for matchValues, each thread needs its own.
+	* It only allocates memory when it is reserved, or when a query has more values than reserved before.
+	*/
+	class Workspace {
+
+	public:
+		Workspace(size_t capacity = 0) { reserve(capacity); }
+
+		void reserve(size_t capacity);
+
+	private:
+		friend class ESeriesSolver;
+		friend struct ChainSearch;
+
+		// A partial sum of a ladder known to have no completion for any total in [low, high], see matchChain
+		struct ChainState {
+			double sum;
+			double low;
+			double high;
+			uint32_t level;
+			uint32_t generation;
+		};
+
+		std::vector<std::pair<double, uint32_t>> sorted;
+		std::vector<double> mantissas;
+		std::vector<uint32_t> index;
+		std::vector<int16_t> exponents;
+		std::vector<uint16_t> indices;
+		std::vector<double> errors;
+		std::vector<ChainState> chainStates;
+		uint32_t chainGeneration = 0;
+
+	};
+
+	ESeriesSolver();
+	~ESeriesSolver();
+
+	/*
+	* Maps the tables from an index file instead of the generated ones, the file stays mapped while the solver exists.
+	* Has to be called before the first query, the tables are only generated by the first query that needs them if no file was mapped.
+	* The index only holds the E-series, so it can not be used together with custom series.
+	* @param path The path of the index file
+	* @returns true if the file was mapped
+	*/
+	bool loadIndex(const char* path);
+
+	/*
+	* Writes all generated tables into an index file, for loadIndex.
+	* @param path The path of the index file
+	* @returns true if the file was written, false as well if custom series are used
+	*/
+	bool writeIndex(const char* path) const;
+
+	/*
+	* Generates the ratio and network indices that were neither generated nor mapped yet, so that no later query allocates memory.
+	* Has to be called after the series are chosen with useCustomSeries or loadIndex.
+	*/
+	void prepare() const;
+
+	/*
+	* Replaces the E-series by custom sets of values, such as the values of a vendor's precision line, which are then tried from the smallest set up.
+	* The values are taken to 1.0 - 10.0, so each value stands for itself in every decade, and the series is named by its number of distinct values.
+	* Has to be called before the first query, and not after an index file was mapped.
+	* @param sets The values of each series, with at most four significant digits
+	* @returns false if a set is empty or too large, has a value with more digits, or has as many values as another set, the E-series are kept then
+	*/
+	bool useCustomSeries(const std::vector<std::vector<double>>& sets);
+
+	/*
+	* Tries to find the first E-series, which's values are close to the provided values.
+	* @param values The values to find a close E-series for
+	* @param maxError The maximum error that is acceptable
+	* @param matches Returns the match for each requested value, in the order of the values, has to hold at least as many entries as there are values
+	* @param workspace The scratch memory of the calling thread
+	* @param largestError Returns the largest error that occurs in the best E-series found, if none was found only an error at least the max. error is returned
+	* @returns The best series found, or zero if none matched the maximum error, the matches are only written if a series was found
+	*/
+	int matchValues(std::span<const double> values, double maxError, std::span<ValueMatch> matches, Workspace& workspace, double* largestError) const;
+
+	/*
+	* Tries to find the first E-series, from which values the requested ratio can be made, while stayng below the requested maximal error.
+	* @param ratio The ratio of the two values
+	* @param maxError The maximum error that is acceptable
+	* @param error The actual error with the found values
+	* @param value1 The first value from the found series
+	* @param value2 The second value from the found series
+	* @returns The series from which the values where taken, or zero if none matched the maximum error
+	*/
+	int matchRatio(double ratio, double maxError, double* error, double* value1, double* value2) const;
+
+	/*
+	* Finds the best pairs of values for the requested ratio across all E-series within the maximal error.
+	* The pairs are ranked by their error and then by the size of their series, a pair found in several series is only listed for the smallest one.
+	* @param ratio The ratio of the two values
+	* @param maxError The maximum error that is acceptable
+	* @param best Returns the best pairs, the best one first, at most as many as it can hold
+	* @returns The number of pairs found
+	*/
+	size_t matchRatios(double ratio, double maxError, std::span<RatioMatch> best) const;
+
+	/*
+	* Tries to find the first E-series, from which values a network of two to four parts for the requested ratio can be made within the maximal error.
+	* Each half of the network is a single value, or two values in series or parallel, all taken from the same series.
+	* Within a series the networks with fewer parts are preferred, only the series up to E96 are searched.
+	* @param ratio The ratio of the two halves of the network
+	* @param maxError The maximum error that is acceptable
+	* @param network Returns the best network of the series found
+	* @returns The series from which the values where taken, or zero if none matched the maximum error
+	*/
+	int matchNetwork(double ratio, double maxError, NetworkMatch* network) const;
+
+	/*
+	* Returns the number of series that are tried, which is the size of an error profile.
+	*/
+	size_t seriesCount() const;
+
+	/*
+	* Returns the values of the first decade (1.0 - <10.0) of a series, the same ones the searches use.
+	* @param seriesIndex The index of the series, in the order in which they are tried
+	* @returns The values, or an empty span if the index is out of range
+	*/
+	std::span<const double> seriesValues(size_t seriesIndex) const;
+
+	/*
+	* Computes the largest error of the values for every E-series in one pass.
+	* The series for any max. error can then be read from the profile with seriesForError, without searching again.
+	* @param values The values to compute the profile for
+	* @param profile Returns the largest error for each series, in the order in which they are tried, has to hold seriesCount() entries
+	* @param workspace The scratch memory of the calling thread
+	*/
+	void errorProfile(std::span<const double> values, std::span<SeriesError> profile, Workspace& workspace) const;
+
+	/*
+	* Reads the first series within the max. error from an error profile.
+	* @param profile The error profile
+	* @param maxError The maximum error that is acceptable
+	* @returns The index of the series in the profile, or -1 if none is within the max. error
+	*/
+	static int seriesForError(std::span<const SeriesError> profile, double maxError);
+
+	/*
+	* Matches the values against one specific E-series, regardless of the error, for example one read from an error profile.
+	* @param values The values to match
+	* @param seriesIndex The index of the series, in the order in which they are tried
+	* @param matches Returns the match for each requested value, in the order of the values
+	* @param workspace The scratch memory of the calling thread
+	* @param largestError Returns the largest error that occurs
+	* @returns The series, or zero if the index is out of range
+	*/
+	int matchValuesInSeries(std::span<const double> values, size_t seriesIndex, std::span<ValueMatch> matches, Workspace& workspace, double* largestError) const;
+
+	/*
+	* Finds the fewest distinct series values, so that every value is within the max. error of one of them, for example to stock the fewest reels for a BOM.
+	* The values keep their decades. All series are tried, and the one needing the fewest parts wins, the smaller series on a tie.
+	* @param values The values to cover
+	* @param maxError The maximum error that is acceptable
+	* @param matches Returns the part chosen for each value, in the order of the values, has to hold at least as many entries as there are values
+	* @param workspace The scratch memory of the calling thread
+	* @param parts Returns the number of distinct parts
+	* @param largestError Returns the largest error of a value to its part
+	* @returns The series the parts are taken from, or zero if no series covers all values, the matches are only written if a series was found
+	*/
+	int minimizeParts(std::span<const double> values, double maxError, std::span<ValueMatch> matches, Workspace& workspace, size_t* parts, double* largestError) const;
+
+	/*
+	* Finds the first E-series with a ladder for a set of taps, the resistors of a ladder are in series and tapped between them.
+	* Within that series the ladder with the fewest distinct values is chosen, and of those the one with the smallest error.
+	* Only the series up to E192 are searched, at most 16 taps are supported.
+	* The search of a series is limited, if very many ladders fit (for taps close together) the best one found until then is returned.
+	* @param taps The ratios of the taps to the whole ladder, in any order, each between 0 and 1 and all different
+	* @param maxError The maximum error of a tap that is acceptable
+	* @param resistors Returns the resistors from the top of the ladder to the bottom, has to hold one more entry than there are taps
+	* @param matches Returns the ratio each tap actually has, in the order of the taps, has to hold as many entries as there are taps
+	* @param workspace Scratch memory for the search
+	* @param distinct Returns the number of distinct values in the ladder
+	* @param largestError Returns the largest error of a tap
+	* @returns The series of the resistors, or zero if no series has a ladder within the max. error
+	*/
+	int matchChain(std::span<const double> taps, double maxError, std::span<double> resistors, std::span<ValueMatch> matches, Workspace& workspace, size_t* distinct, double* largestError) const;
+
+private:
+	// The tables are either generated into the storage on first use, or point into a mapped index file
+	mutable std::once_flag ratiosBuilt;
+	mutable std::vector<std::vector<RatioEntry>> ratioTables;
+	mutable std::vector<std::span<const RatioEntry>> ratioIndices;
+	mutable std::once_flag networkBuilt;
+	mutable std::vector<std::vector<NetworkHalf>> networkTables;
+	mutable std::vector<std::span<const NetworkHalf>> networkSingles;
+	mutable std::vector<std::span<const NetworkHalf>> networkPairs;
+	std::unique_ptr<MappedFile> indexFile;
+	// The series tried, either the E-series or the custom ones, and the index of the first one containing all values of the ones before
+	std::span<const SeriesDescriptor> ladder;
+	size_t firstComputed;
+	std::unique_ptr<CustomSeries> customSeries;
+
+	static void normalizeValues(std::span<const double> values, Workspace& workspace);
+	static void publishMatches(const SeriesDescriptor& series, std::span<const double> values, std::span<ValueMatch> matches, const Workspace& workspace);
+	static double matchSeries(const SeriesDescriptor& series, Workspace& workspace, double bound);
+	static size_t coverValues(const SeriesDescriptor& series, std::span<const double> values, double maxError, size_t limit, std::span<ValueMatch> matches, const Workspace& workspace);
+	void buildRatioIndices() const;
+	void buildNetworkIndex() const;
+
+};
+
+/*
+* The values of an inventory, for matching against the values that are actually available instead of an E-series.
+* The values keep their decades, and are stored in Eytzinger order so that the search walks the array front to back.
+* The index is built once, and can then be queried from any number of threads at the same time.
+*/
+class StockIndex {
+
+public:
+	/*
+	* Builds the index, invalid values (zero, negative or not finite) are dropped and duplicates merged.
+	*/
+	StockIndex(std::span<const double> values);
+
+	/*
+	* Returns the number of distinct values in stock.
+	*/
+	size_t size() const { return sorted.size(); }
+
+	/*
+	* Finds the value in stock closest to the requested value.
+	* @param value The requested value
+	* @param error Returns the error of the closest value
+	* @returns The closest value, or zero if the stock is empty or the value invalid
+	*/
+	double nearest(double value, double* error) const;
+
+	/*
+	* Matches every value to the closest value in stock.
+	* @param values The values to match
+	* @param maxError The maximum error that is acceptable
+	* @param matches Returns the match for each requested value, in the order of the values, has to hold at least as many entries as there are values
+	* @param largestError Returns the largest error that occurs
+	* @returns true if all values are within the maximum error
+	*/
+	bool matchValues(std::span<const double> values, double maxError, std::span<ValueMatch> matches, double* largestError) const;
+
+	/*
+	* Finds the pair of values in stock closest to the requested ratio.
+	* @param ratio The ratio of the two values
+	* @param maxError The maximum error that is acceptable
+	* @param error Returns the error of the best pair
+	* @param value1 Returns the first value of the best pair
+	* @param value2 Returns the second value of the best pair
+	* @returns true if the best pair is within the maximum error
+	*/
+	bool matchRatio(double ratio, double maxError, double* error, double* value1, double* value2) const;
+
+private:
+	std::vector<double> sorted;
+	std::vector<double> tree;
+	std::vector<uint32_t> rank;
+
+	size_t fillTree(size_t i, size_t k);
+
+};
+
+/*
+* The divider simulated by the yield analysis, both values are spread uniformly within the tolerance of the parts.
+* Each part also has a temperature coefficient spread uniformly within the given tempco, and both drift over the same temperature,
+* which is spread uniformly over the given range around the reference temperature of the tempco.
+*/
+struct YieldModel {
+	double ratio;
+	double value1;
+	double value2;
+	double tolerance;
+	double tempco;
+	double temperature;
+	double maxError;
+	uint64_t seed;
+};
+
+/*
+* Returns the usual tolerance of the parts of an E-series, 0.1 % for the series beyond E192.
+*/
+double seriesTolerance(uint16_t series);
+
+/*
+* Monte-Carlo analysis of the ratio a divider actually has, as histogram of the ratio errors of the simulated samples.
+* The samples are drawn from a counter based generator (Philox 4x32-10) keyed with the seed, the number of the sample is the counter.
+* Any range of samples can therefore be simulated by any thread, and the merged result does not depend on how the samples were split.
+*/
+class YieldAnalysis {
+
+public:
+	YieldAnalysis(const YieldModel& model);
+
+	/*
+	* Simulates the samples [first, first + count) and adds them to the histogram.
+	*/
+	void simulate(uint64_t first, uint64_t count);
+
+	/*
+	* Adds the samples of another analysis of the same model.
+	*/
+	void merge(const YieldAnalysis& other);
+
+	/*
+	* Returns the number of simulated samples.
+	*/
+	uint64_t samples() const { return sampled; }
+
+	/*
+	* Returns the fraction of the samples with a ratio error within the max. error of the model.
+	*/
+	double within() const { return sampled == 0 ? 0.0 : (double) inside / (double) sampled; }
+
+	/*
+	* Returns the largest ratio error of all samples.
+	*/
+	double largestError() const { return largest; }
+
+	/*
+	* Returns the ratio error that the given fraction of the samples does not exceed, accurate to 1/4096 of the largest possible error.
+	*/
+	double percentile(double fraction) const;
+
+private:
+	YieldModel model;
+	double range;
+	std::vector<uint64_t> bins;
+	uint64_t sampled;
+	uint64_t inside;
+	double largest;
+
+};
@@ -1,6 +1,25 @@
 ﻿/*
 * This is a simple tool for finding a matching E-series for provided resistor values (or other component values utilizing the E-series)
 * Simply provide the required values as list to the executable when calling it in the terminal, plus -err followed by the required max. error (in percent)
+* With -f followed by a file (or - for stdin), one query per line is read and one result per line is written instead
+* The results are written as text, or with --format as csv, tsv or json, the boxed output is only used for a single query on the terminal
+* With --sweep, the series for a range of tolerances are listed instead, computed from a single pass over all series
+* With --minimize-parts, the fewest distinct series values covering all values within the max. error are chosen instead
+* With --chain, the values are the taps of a resistor ladder (as ratio to the whole ladder), which is built from one series sharing as many values as possible
+* With -top followed by a number, the ratio search lists that many of the best pairs across all series instead of the first match
+* With -network, the ratio search also tries networks of three or four values in series and parallel
+* With --yield followed by a number of samples, the spread of the found ratio is simulated from the part tolerance (--part-tolerance, in percent) and tempco (--tempco, in ppm/K)
+* With --build-index followed by a file, the generated tables are written to that file, which --index followed by the file maps on later starts
+* With --stock followed by a file of values (one per line, with decades), values and ratios are matched against that inventory instead of the E-series
+* With --series followed by a file of values (one per line, each standing for all its decades), the E-series are replaced by that set, such as a vendor's precision line
+* --series can be given several times, the sets are tried from the smallest up and named by their number of values like the E-series
+* With -j followed by a number of threads (0 for all cores, at most 1024), the queries of the streaming mode are solved in parallel
+* With --stats, the work counters and stage timings are written to stderr, as text or as a JSON line for the csv, tsv and json formats (only if built with FIND_E_STATS)
+* With --serve followed by a name, queries are answered over the named pipe \\.\pipe\<name> (or the unix socket <name> on other platforms)
+* The streaming and server modes keep the results of single values and ratios in a cache, --cache followed by a number of entries sets its size (0 to disable it)
+* Values can be given with SI prefixes (4.7k, 100n) or in RKM notation (4k7, 2R2)
+* The solver itself is a separate library (e_series_solver.h / e_series_solver.cpp), this file only contains the command line tool
+* The benchmarks of the solver against the original algorithms of this tool are a separate program (find_e_benchmark.cpp)
 * 
 * Copyright 2024 M_Marvin (Discord, GitHub)
 * 
@@ -16,312 +35,2455 @@
 */
 
 
+#include "e_series_solver.h"
+
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <vector>
-#include <map>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <bit>
+#include <algorithm>
+#include <charconv>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <stdint.h>
+#include <stdarg.h>
 
-// For setting the terminal mode
+// For the console output, and the named pipe or unix socket of the server mode
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
 #include <io.h>
-#include <fcntl.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+using namespace std;
+
+/* The solver used for all queries, it is constructed once on startup, and can map an index file before the first query */
+static ESeriesSolver solver = ESeriesSolver();
+
+/* Reported as the series of results matched against the inventory */
+static constexpr uint16_t STOCK_SERIES = UINT16_MAX;
+
+/* The largest number of ranked pairs a ratio query can ask for */
+static constexpr unsigned MAX_TOP = 4096;
+
+/* The tolerances listed by the sweep of a value query */
+static constexpr double SWEEP_TOLERANCES[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2 };
+
+/* The percentiles of the ratio error reported by the yield analysis */
+static constexpr double YIELD_PERCENTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+/* The largest number of samples of a yield analysis */
+static constexpr double MAX_YIELD = 1e12;
+
+/* The samples of a yield analysis simulated by one chunk of the thread pool */
+static constexpr uint64_t YIELD_CHUNK = 1 << 20;
+
+/* The temperature range of the yield analysis, in kelvin around the reference temperature of the tempco */
+static constexpr double YIELD_TEMPERATURE = 60.0;
+
+/* The tolerance assumed for parts from the inventory, unless another one is given */
+static constexpr double STOCK_TOLERANCE = 0.01;
+
+/* The key of the random numbers of the yield analysis, fixed so that the results are reproducible */
+static constexpr uint64_t YIELD_SEED = 0x66696E6445;
+
+/* The largest number of threads -j can ask for */
+static constexpr unsigned MAX_THREADS = 1024;
+
+/* The number of results kept by the result cache of the streaming and server modes, unless another number is given */
+static constexpr size_t CACHE_ENTRIES = 1 << 16;
+
+/* The result cache is split into this many shards, each with its own lock for storing results */
+static constexpr size_t CACHE_SHARDS = 64;
+
+/* The number of entries of one set of the result cache, a key can only be stored in the entries of its set */
+static constexpr size_t CACHE_WAYS = 8;
+
+/*
+* Buffered output of UTF-8 text, the text is collected and written to the file (or another sink) in large chunks.
+*/
+class OutputBuffer {
+
+public:
+	OutputBuffer(FILE* file) : sink([file](const char* data, size_t length) { fwrite(data, 1, length, file); fflush(file); }), used(0) {}
+	OutputBuffer(function<void(const char*, size_t)> sink) : sink(sink), used(0) {}
+	~OutputBuffer() { flush(); }
+
+	void write(const char* text, size_t length) {
+		if (used + length > sizeof(buffer)) {
+			flush();
+			if (length > sizeof(buffer)) {
+				sink(text, length);
+				return;
+			}
+		}
+		memcpy(buffer + used, text, length);
+		used += length;
+	}
+
+	void write(const char* text) {
+		write(text, strlen(text));
+	}
+
+	void write(char c) {
+		if (used == sizeof(buffer)) flush();
+		buffer[used++] = c;
+	}
+
+	/*
+	* Writes a number in its shortest form with the requested number of significant digits
+	*/
+	void writeNumber(double value, int precision = 6) {
+		char text[32];
+		to_chars_result result = to_chars(text, text + sizeof(text), value, chars_format::general, precision);
+		write(text, result.ptr - text);
+	}
+
+	/*
+	* Writes a number with a fixed number of decimal places
+	*/
+	void writeFixed(double value, int precision) {
+		char text[64];
+		to_chars_result result = to_chars(text, text + sizeof(text), value, chars_format::fixed, precision);
+		write(text, result.ptr - text);
+	}
+
+	void writeNumber(uint64_t value) {
+		char text[24];
+		to_chars_result result = to_chars(text, text + sizeof(text), value);
+		write(text, result.ptr - text);
+	}
+
+	void flush() {
+		if (used > 0) sink(buffer, used);
+		used = 0;
+	}
+
+private:
+	function<void(const char*, size_t)> sink;
+	size_t used;
+	char buffer[1 << 16];
+
+};
+
+#if defined(_WIN32)
+/*
+* Returns the console stdout is attached to, with escape sequences enabled on it, or nullptr if stdout is redirected.
+*/
+HANDLE consoleHandle() {
+	HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD mode;
+	if (handle == INVALID_HANDLE_VALUE || !GetConsoleMode(handle, &mode)) return nullptr;
+	SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	return handle;
+}
+#endif
+
+/*
+* Writes the UTF-8 text of the boxes to stdout.
+* A Windows console gets a whole chunk converted to UTF-16 through WriteConsoleW, since its code page is not necessarily UTF-8,
+* anything else gets the bytes as they are. The chunks of an OutputBuffer end after a complete write, so no character is split.
+*/
+void writeConsole(const char* data, size_t length) {
+#if defined(_WIN32)
+	static const HANDLE handle = consoleHandle();
+	if (handle != nullptr) {
+		static vector<wchar_t> wide = vector<wchar_t>();
+		wide.resize(length);
+		int count = MultiByteToWideChar(CP_UTF8, 0, data, (int) length, wide.data(), (int) wide.size());
+		for (int done = 0; done < count;) {
+			DWORD written;
+			if (!WriteConsoleW(handle, wide.data() + done, (DWORD) (count - done), &written, nullptr) || written == 0) return;
+			done += (int) written;
+		}
+		return;
+	}
+#endif
+	fwrite(data, 1, length, stdout);
+	fflush(stdout);
+}
+
+/* The output of the boxes, written in chunks once the buffer is full and on exit, instead of converting and flushing every line */
+static OutputBuffer console = OutputBuffer(writeConsole);
+
+/*
+* Formats a line of the boxes into the console buffer, like printf.
+*/
+void consolePrintf(const char* format, ...) {
+	char line[256];
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+	if (length > 0) console.write(line, min((size_t) length, sizeof(line) - 1));
+}
+
+/*
+* Formats a value with an SI prefix, so that at most three digits are in front of the decimal point
+* Example: 4700 -> 4.700k	0.0022 -> 2.200m
+* @param value The value to format
+* @param buffer The buffer to write the formated value to
+* @param size The size of the buffer
+*/
+void formatValue(double value, char* buffer, size_t size) {
+
+	static const char PREFIXES[] = "pnum kMG";
+
+	int exponent;
+	cutDown(value, &exponent);
+	int group = min(max((int) floor(exponent / 3.0), -4), 3);
+	double scaled = scaleDecade(value, -3 * group);
+	char prefix = PREFIXES[group + 4];
+
+	if (prefix == ' ') {
+		snprintf(buffer, size, "%.3lf", scaled);
+	} else {
+		snprintf(buffer, size, "%.3lf%c", scaled, prefix);
+	}
+
+}
+
+void findBestForRatio(double ratio, double maxError) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Atrying to find best E-series\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	double error = 0.0;
+	double value1 = 0.0;
+	double value2 = 0.0;
+	uint16_t series = solver.matchRatio(ratio, maxError, &error, &value1, &value2);
+
+	if (series == 0) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Aerror: \033[38;5;190m%.2lf %%\033[0m\n", error * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║ R_1        ┆ R_2        ┆ ratio       ║\n");
+
+	consolePrintf("║            ┆            ┆             ║\n");
+	consolePrintf("  \033[1A \033[38;5;76m%.3lf\033[0m\n", value1);
+	consolePrintf("               \033[1A \033[38;5;76m%.3lf\033[0m\n", value2);
+	consolePrintf("                            \033[1A \033[38;5;190m%.2lf\033[0m\n", value1 / value2);
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+void findBestPairsForRatio(double ratio, double maxError, unsigned top) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Aranking the best %u pairs\n", top);
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	vector<RatioMatch> ranked = vector<RatioMatch>(top);
+	ranked.resize(solver.matchRatios(ratio, maxError, ranked));
+
+	if (ranked.empty()) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║ series ┆ R_1      ┆ R_2      ┆ error  ║\n");
+
+	for (const RatioMatch& match : ranked) {
+
+		consolePrintf("║        ┆          ┆          ┆        ║\n");
+		consolePrintf("  \033[1A \033[38;5;76mE%u\033[0m\n", match.series);
+		consolePrintf("           \033[1A \033[38;5;76m%.3lf\033[0m\n", match.value1);
+		consolePrintf("                      \033[1A \033[38;5;76m%.3lf\033[0m\n", match.value2);
+		consolePrintf("                                 \033[1A \033[38;5;190m%.2lf %%\033[0m\n", match.error * 100.0);
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+/*
+* Prints one half of a network as a line of the box.
+*/
+void printNetworkHalf(const char* name, const NetworkHalf& half) {
+	consolePrintf("║                                       ║\n");
+	if (half.branch == BRANCH_SINGLE) {
+		consolePrintf("  \033[1A%s: \033[38;5;76m%.3lf\033[0m\n", name, half.value1);
+	} else {
+		consolePrintf("  \033[1A%s: \033[38;5;76m%.3lf\033[0m %s \033[38;5;76m%.3lf\033[0m\n", name, half.value1, half.branch == BRANCH_SERIES ? "+" : "‖", half.value2);
+	}
+}
+
+void findBestNetworkForRatio(double ratio, double maxError) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Atrying to find best network\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	NetworkMatch network = NetworkMatch();
+	uint16_t series = solver.matchNetwork(ratio, maxError, &network);
+
+	if (series == 0) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Aerror: \033[38;5;190m%.2lf %%\033[0m\n", network.error * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	printNetworkHalf("upper", network.upper);
+	printNetworkHalf("lower", network.lower);
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+void findBestForValues(const vector<double>& values, double maxError) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Atrying to find best E-series\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	double largestError = 0.0;
+	vector<ValueMatch> matches = vector<ValueMatch>(values.size());
+	ESeriesSolver::Workspace workspace = ESeriesSolver::Workspace(values.size());
+	uint16_t series = solver.matchValues(values, maxError, matches, workspace, &largestError);
+
+	if (series == 0) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Alargest error: \033[38;5;190m%.2lf %%\033[0m\n", largestError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║ R_orig     ┆ R_series   ┆ error       ║\n");
+
+	for (const ValueMatch& match : matches) {
+	
+		char original[16];
+		char seriesValue[16];
+		formatValue(match.original, original, 16);
+		formatValue(match.seriesValue, seriesValue, 16);
+
+		consolePrintf("║            ┆            ┆             ║\n");
+		consolePrintf("  \033[1A \033[38;5;76m%s\033[0m\n", original);
+		consolePrintf("               \033[1A \033[38;5;76m%s\033[0m\n", seriesValue);
+		consolePrintf("                            \033[1A \033[38;5;190m%.2lf %%\033[0m\n", match.error * 100.0);
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+void findFewestParts(const vector<double>& values, double maxError) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Atrying to find fewest parts\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	size_t parts = 0;
+	double largestError = 0.0;
+	vector<ValueMatch> matches = vector<ValueMatch>(values.size());
+	ESeriesSolver::Workspace workspace = ESeriesSolver::Workspace(values.size());
+	uint16_t series = solver.minimizeParts(values, maxError, matches, workspace, &parts, &largestError);
+
+	if (series == 0) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Adistinct parts: \033[38;5;76m%zu\033[0m\n", parts);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Alargest error: \033[38;5;190m%.2lf %%\033[0m\n", largestError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║ R_orig     ┆ R_part     ┆ error       ║\n");
+
+	for (const ValueMatch& match : matches) {
+
+		char original[16];
+		char part[16];
+		formatValue(match.original, original, 16);
+		formatValue(match.seriesValue, part, 16);
+
+		consolePrintf("║            ┆            ┆             ║\n");
+		consolePrintf("  \033[1A \033[38;5;76m%s\033[0m\n", original);
+		consolePrintf("               \033[1A \033[38;5;76m%s\033[0m\n", part);
+		consolePrintf("                            \033[1A \033[38;5;190m%.2lf %%\033[0m\n", match.error * 100.0);
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+void findLadderForTaps(const vector<double>& taps, double maxError) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Atrying to find best ladder\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	size_t distinct = 0;
+	double largestError = 0.0;
+	vector<double> resistors = vector<double>(taps.size() + 1);
+	vector<ValueMatch> matches = vector<ValueMatch>(taps.size());
+	ESeriesSolver::Workspace workspace = ESeriesSolver::Workspace(taps.size());
+	uint16_t series = solver.matchChain(taps, maxError, resistors, matches, workspace, &distinct, &largestError);
+
+	if (series == 0) {
+
+		consolePrintf("╔═══════════════════════════════════════╗\n");
+		consolePrintf("║                                       ║\n");
+		consolePrintf("  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
+		consolePrintf("╚═══════════════════════════════════════╝\n");
+
+		return;
+
+	}
+
+	// The taps from the top of the ladder down, each printed below the resistor above it
+	vector<const ValueMatch*> ordered = vector<const ValueMatch*>();
+	for (const ValueMatch& match : matches) ordered.push_back(&match);
+	sort(ordered.begin(), ordered.end(), [](const ValueMatch* a, const ValueMatch* b) { return a->original > b->original; });
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Adistinct values: \033[38;5;76m%zu\033[0m\n", distinct);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Alargest error: \033[38;5;190m%.2lf %%\033[0m\n", largestError * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║ R          ┆ tap        ┆ error       ║\n");
+
+	for (size_t i = 0; i < resistors.size(); i++) {
+
+		char resistor[16];
+		formatValue(resistors[i], resistor, 16);
+
+		consolePrintf("║            ┆            ┆             ║\n");
+		consolePrintf("  \033[1A \033[38;5;76m%s\033[0m\n", resistor);
+		if (i == ordered.size()) continue;
+
+		consolePrintf("║            ┆            ┆             ║\n");
+		consolePrintf("               \033[1A \033[38;5;76m%.4lf\033[0m\n", ordered[i]->seriesValue);
+		consolePrintf("                            \033[1A \033[38;5;190m%.2lf %%\033[0m\n", ordered[i]->error * 100.0);
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+void findBestForTolerances(const vector<double>& values) {
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Acomputing error profile of all series\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+	ESeriesSolver::Workspace workspace = ESeriesSolver::Workspace(values.size());
+	vector<SeriesError> profile = vector<SeriesError>(solver.seriesCount());
+	solver.errorProfile(values, profile, workspace);
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║ max. error ┆ series     ┆ error       ║\n");
+
+	for (double tolerance : SWEEP_TOLERANCES) {
+
+		int s = ESeriesSolver::seriesForError(profile, tolerance);
+
+		consolePrintf("║            ┆            ┆             ║\n");
+		consolePrintf("  \033[1A \033[38;5;190m%.2lf %%\033[0m\n", tolerance * 100.0);
+		if (s < 0) {
+			consolePrintf("               \033[1A \033[38;5;196mnone\033[0m\n");
+		} else {
+			consolePrintf("               \033[1A \033[38;5;76mE%u\033[0m\n", profile[s].series);
+			consolePrintf("                            \033[1A \033[38;5;190m%.2lf %%\033[0m\n", profile[s].largestError * 100.0);
+		}
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+/*
+* Parses a component value, plain (4700, 4.7e3), with an SI prefix (4.7k, 10M, 2.2u) or in RKM notation (4k7, 2R2, 1M5).
+* The whole text has to be consumed, nothing is allocated.
+* @param begin The start of the text
+* @param end The end of the text
+* @param value Returns the parsed value
+* @returns true if the text is a valid value
+*/
+bool parseValue(const char* begin, const char* end, double* value) {
+
+	double number;
+	from_chars_result result = from_chars(begin, end, number);
+	if (result.ec != errc() || result.ptr == begin) return false;
+	const char* c = result.ptr;
+	if (c == end) {
+		*value = number;
+		return true;
+	}
+
+	double multiplier;
+	switch (*c) {
+		case 'p': multiplier = 1e-12; break;
+		case 'n': multiplier = 1e-9; break;
+		case 'u': multiplier = 1e-6; break;
+		case 'm': multiplier = 1e-3; break;
+		case 'R':
+		case 'r': multiplier = 1.0; break;
+		case 'k':
+		case 'K': multiplier = 1e3; break;
+		case 'M': multiplier = 1e6; break;
+		case 'G': multiplier = 1e9; break;
+		case '\xC2':
+			// UTF-8 encoded micro sign
+			if (end - c < 2 || c[1] != '\xB5') return false;
+			multiplier = 1e-6;
+			c++;
+			break;
+		default: return false;
+	}
+	c++;
+
+	// RKM notation, the digits following the prefix are the decimal places
+	if (c != end) {
+		if (memchr(begin, '.', result.ptr - begin) != nullptr) return false;
+		double scale = 0.1;
+		for (; c != end; c++) {
+			if (*c < '0' || *c > '9') return false;
+			number += (*c - '0') * scale;
+			scale /= 10.0;
+		}
+	}
+
+	*value = number * multiplier;
+	return true;
+
+}
+
+enum QueryKind {
+	QUERY_EMPTY,
+	QUERY_INVALID,
+	QUERY_VALUES,
+	QUERY_RATIO,
+	QUERY_SWEEP,
+	QUERY_NETWORK,
+	QUERY_MINIMIZE,
+	QUERY_CHAIN
+};
+
+/*
+* The settings applied to all queries, unless a query overrides them.
+*/
+struct QueryOptions {
+	double maxError;
+	bool sweep;
+	bool minimize;
+	bool chain;
+	unsigned top;
+	bool network;
+	const StockIndex* stock;
+	uint64_t yieldSamples;
+	double partTolerance;
+	double tempco;
+	bool stats;
+};
+
+/*
+* The work done for a query and the time spent in each stage, in nanoseconds, only measured when built with FIND_E_STATS.
+* The cache lookups are counted in all builds, at most one per query.
+*/
+struct QueryStats {
+	SolverStats solver;
+	uint64_t parseTime;
+	uint64_t solveTime;
+	uint64_t yieldTime;
+	uint64_t cacheLookups;
+	uint64_t cacheHits;
+};
+
+/*
+* The result of the yield analysis of a ratio query, the errors are relative to the requested ratio.
+*/
+struct YieldResult {
+	uint64_t samples;
+	double tolerance;
+	double within;
+	double largestError;
+	double percentiles[size(YIELD_PERCENTILES)];
+};
+
+/*
+* A query of the streaming mode, together with its result once solved.
+*/
+struct Query {
+	QueryKind kind;
+	double maxError;
+	vector<double> values;
+	uint16_t series;
+	double error;
+	size_t parts;
+	double value1;
+	double value2;
+	unsigned top;
+	const StockIndex* stock;
+	vector<ValueMatch> matches;
+	vector<double> resistors;
+	vector<SeriesError> profile;
+	vector<RatioMatch> ranked;
+	NetworkMatch network;
+	uint64_t yieldSamples;
+	double partTolerance;
+	double tempco;
+	YieldResult yield;
+	QueryStats stats;
+};
+
+/*
+* The current time of a monotonic clock in nanoseconds, always zero without FIND_E_STATS.
+*/
+uint64_t statsClock() {
+#if defined(FIND_E_STATS)
+	return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	return 0;
+#endif
+}
+
+/*
+* Adds the time until it goes out of scope to a stage time, in nanoseconds.
+* Without FIND_E_STATS it measures nothing, and compiles to nothing.
+*/
+class StageTimer {
+
+public:
+#if defined(FIND_E_STATS)
+	StageTimer(uint64_t& elapsed) : elapsed(elapsed), start(statsClock()) {}
+	~StageTimer() { elapsed += statsClock() - start; }
+
+private:
+	uint64_t& elapsed;
+	uint64_t start;
+#else
+	StageTimer(uint64_t&) {}
+	~StageTimer() {}
+#endif
+
+};
+
+/*
+* Adds the counters of the solver work done by the calling thread until it goes out of scope, the same way as StageTimer.
+*/
+class WorkCounter {
+
+public:
+#if defined(FIND_E_STATS)
+	WorkCounter(SolverStats& work) : work(work), start(solverStats()) {}
+	~WorkCounter() {
+		const SolverStats& now = solverStats();
+		work.seriesTried += now.seriesTried - start.seriesTried;
+		work.candidates += now.candidates - start.candidates;
+		work.powerCalls += now.powerCalls - start.powerCalls;
+		work.lookupHits += now.lookupHits - start.lookupHits;
+		work.indexSearches += now.indexSearches - start.indexSearches;
+	}
+
+private:
+	SolverStats& work;
+	SolverStats start;
+#else
+	WorkCounter(SolverStats&) {}
+	~WorkCounter() {}
+#endif
+
+};
+
+/*
+* The totals of the stats of all queries of a run, collected by the thread writing the results.
+* The stage times are summed over all threads, so with several workers they can add up to more than the wall time.
+*/
+struct StatsSummary {
+	size_t queries;
+	QueryStats total;
+	uint64_t writeTime;
+	uint64_t wallTime;
+	size_t slowestQuery;
+	uint64_t slowestTime;
+
+	void add(size_t number, const QueryStats& stats) {
+		queries++;
+		total.solver.seriesTried += stats.solver.seriesTried;
+		total.solver.candidates += stats.solver.candidates;
+		total.solver.powerCalls += stats.solver.powerCalls;
+		total.solver.lookupHits += stats.solver.lookupHits;
+		total.solver.indexSearches += stats.solver.indexSearches;
+		total.parseTime += stats.parseTime;
+		total.solveTime += stats.solveTime;
+		total.yieldTime += stats.yieldTime;
+		total.cacheLookups += stats.cacheLookups;
+		total.cacheHits += stats.cacheHits;
+		uint64_t time = stats.parseTime + stats.solveTime + stats.yieldTime;
+		if (time > slowestTime || slowestQuery == 0) {
+			slowestQuery = number;
+			slowestTime = time;
+		}
+	}
+
+	/*
+	* Writes the summary to stderr, as text or as a single JSON object on one line.
+	*/
+	void report(bool json) const {
+		const SolverStats& work = total.solver;
+		if (json) {
+			fprintf(stderr, "{\"stats\":{\"queries\":%llu,\"series_tried\":%llu,\"candidates\":%llu,\"power_calls\":%llu,\"lookup_hits\":%llu,\"index_searches\":%llu,"
+				"\"cache_lookups\":%llu,\"cache_hits\":%llu,\"parse_ns\":%llu,\"solve_ns\":%llu,\"yield_ns\":%llu,\"write_ns\":%llu,\"wall_ns\":%llu,\"slowest_query\":%llu,\"slowest_ns\":%llu}}\n",
+				(unsigned long long) queries, (unsigned long long) work.seriesTried, (unsigned long long) work.candidates, (unsigned long long) work.powerCalls,
+				(unsigned long long) work.lookupHits, (unsigned long long) work.indexSearches, (unsigned long long) total.cacheLookups, (unsigned long long) total.cacheHits, (unsigned long long) total.parseTime, (unsigned long long) total.solveTime,
+				(unsigned long long) total.yieldTime, (unsigned long long) writeTime, (unsigned long long) wallTime, (unsigned long long) slowestQuery, (unsigned long long) slowestTime);
+			return;
+		}
+		fprintf(stderr, "queries:        %llu\n", (unsigned long long) queries);
+		fprintf(stderr, "series tried:   %llu\n", (unsigned long long) work.seriesTried);
+		fprintf(stderr, "candidates:     %llu\n", (unsigned long long) work.candidates);
+		fprintf(stderr, "power calls:    %llu\n", (unsigned long long) work.powerCalls);
+		fprintf(stderr, "lookup hits:    %llu\n", (unsigned long long) work.lookupHits);
+		fprintf(stderr, "index searches: %llu\n", (unsigned long long) work.indexSearches);
+		fprintf(stderr, "cache hits:     %llu of %llu\n", (unsigned long long) total.cacheHits, (unsigned long long) total.cacheLookups);
+		fprintf(stderr, "parse:          %.3lf ms\n", total.parseTime / 1e6);
+		fprintf(stderr, "solve:          %.3lf ms\n", total.solveTime / 1e6);
+		fprintf(stderr, "yield:          %.3lf ms\n", total.yieldTime / 1e6);
+		fprintf(stderr, "write:          %.3lf ms\n", writeTime / 1e6);
+		fprintf(stderr, "wall:           %.3lf ms\n", wallTime / 1e6);
+		if (queries > 0) fprintf(stderr, "slowest:        query %llu, %.3lf ms\n", (unsigned long long) slowestQuery, slowestTime / 1e6);
+	}
+
+};
+
+/*
+* The kinds of queries the result cache holds, part of the key so that a value and a ratio with the same mantissa do not collide.
+*/
+enum CacheKind : uint8_t {
+	CACHE_VALUE = 1,
+	CACHE_RATIO = 2
+};
+
+/*
+* A result of the cache, for a value or ratio transformed to 1.0 - 10.0.
+* For a value, value1 is the series value and value2 the rounded mantissa the solver matched, for a ratio they are the pair.
+*/
+struct CacheResult {
+	uint16_t series;
+	double error;
+	double value1;
+	double value2;
+};
+
+/*
+* A fixed size cache of the results of single value and ratio queries, shared by all threads of the streaming and server modes.
+* The entries are grouped in sets of CACHE_WAYS, replaced by the CLOCK algorithm within their set, and the sets are spread over CACHE_SHARDS locks.
+* Only storing a result takes the lock of its shard, looking up a result is lock free: each entry has a sequence number which is odd while
+* the entry is written, a reader which sees it odd or changed after copying the entry treats the lookup as a miss.
+*/
+class ResultCache {
+
+public:
+	/*
+	* Allocates the cache.
+	* @param entries The number of results to keep, rounded up to a power of two of at least one set per shard
+	*/
+	ResultCache(size_t entries) : sets(bit_ceil(max(entries / CACHE_WAYS, CACHE_SHARDS))), entries(new Entry[sets * CACHE_WAYS]), hands(sets, 0), locks(CACHE_SHARDS) {}
+
+	/*
+	* Looks up a result.
+	* @param kind The kind of query
+	* @param mantissa The key of the value or ratio, see cacheKey
+	* @param maxError The max. error of the query
+	* @param result The result to fill in
+	* @returns true if the result was found
+	*/
+	bool find(CacheKind kind, double mantissa, double maxError, CacheResult* result) const {
+		size_t set = setOf(kind, mantissa, maxError);
+		for (size_t i = 0; i < CACHE_WAYS; i++) {
+			Entry& entry = entries[set * CACHE_WAYS + i];
+			uint32_t sequence = entry.sequence.load(memory_order_acquire);
+			if (sequence == 0 || (sequence & 1) != 0) continue;
+			if (entry.kind.load(memory_order_relaxed) != kind || entry.mantissa.load(memory_order_relaxed) != bit_cast<uint64_t>(mantissa) ||
+				entry.maxError.load(memory_order_relaxed) != bit_cast<uint64_t>(maxError)) continue;
+			CacheResult found;
+			found.series = entry.series.load(memory_order_relaxed);
+			found.error = bit_cast<double>(entry.error.load(memory_order_relaxed));
+			found.value1 = bit_cast<double>(entry.value1.load(memory_order_relaxed));
+			found.value2 = bit_cast<double>(entry.value2.load(memory_order_relaxed));
+			atomic_thread_fence(memory_order_acquire);
+			if (entry.sequence.load(memory_order_relaxed) != sequence) return false;
+			// Only written if not set yet, so that hits on the same entry from several threads do not keep moving its cache line
+			if (entry.referenced.load(memory_order_relaxed) == 0) entry.referenced.store(1, memory_order_relaxed);
+			*result = found;
+			return true;
+		}
+		return false;
+	}
+
+	/*
+	* Stores a result, replacing the first entry of its set not referenced since the clock hand passed it last.
+	* @param kind The kind of query
+	* @param mantissa The key of the value or ratio, see cacheKey
+	* @param maxError The max. error of the query
+	* @param result The result to store
+	*/
+	void store(CacheKind kind, double mantissa, double maxError, const CacheResult& result) {
+		size_t set = setOf(kind, mantissa, maxError);
+		lock_guard<mutex> lock = lock_guard<mutex>(locks[set % CACHE_SHARDS]);
+
+		// Another thread can have stored the same result since the lookup
+		for (size_t i = 0; i < CACHE_WAYS; i++) {
+			const Entry& entry = entries[set * CACHE_WAYS + i];
+			if (entry.sequence.load(memory_order_relaxed) != 0 && entry.kind.load(memory_order_relaxed) == kind &&
+				entry.mantissa.load(memory_order_relaxed) == bit_cast<uint64_t>(mantissa) && entry.maxError.load(memory_order_relaxed) == bit_cast<uint64_t>(maxError)) return;
+		}
+
+		Entry* victim;
+		while (true) {
+			victim = &entries[set * CACHE_WAYS + hands[set]];
+			hands[set] = (uint8_t) ((hands[set] + 1) % CACHE_WAYS);
+			if (victim->referenced.exchange(0, memory_order_relaxed) == 0) break;
+		}
+
+		uint32_t sequence = victim->sequence.load(memory_order_relaxed);
+		victim->sequence.store(sequence + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		victim->kind.store(kind, memory_order_relaxed);
+		victim->series.store(result.series, memory_order_relaxed);
+		victim->mantissa.store(bit_cast<uint64_t>(mantissa), memory_order_relaxed);
+		victim->maxError.store(bit_cast<uint64_t>(maxError), memory_order_relaxed);
+		victim->error.store(bit_cast<uint64_t>(result.error), memory_order_relaxed);
+		victim->value1.store(bit_cast<uint64_t>(result.value1), memory_order_relaxed);
+		victim->value2.store(bit_cast<uint64_t>(result.value2), memory_order_relaxed);
+		victim->sequence.store(sequence + 2, memory_order_release);
+	}
+
+private:
+	/*
+	* One result, all fields are atomic so that they can be read while being replaced, the doubles are stored as their bits.
+	*/
+	struct alignas(64) Entry {
+		atomic<uint32_t> sequence;
+		atomic<uint8_t> referenced;
+		atomic<uint8_t> kind;
+		atomic<uint16_t> series;
+		atomic<uint64_t> mantissa;
+		atomic<uint64_t> maxError;
+		atomic<uint64_t> error;
+		atomic<uint64_t> value1;
+		atomic<uint64_t> value2;
+	};
+
+	size_t setOf(CacheKind kind, double mantissa, double maxError) const {
+		uint64_t hash = bit_cast<uint64_t>(mantissa) ^ (bit_cast<uint64_t>(maxError) * 0x9E3779B97F4A7C15) ^ kind;
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCD;
+		hash ^= hash >> 33;
+		return (size_t) (hash & (sets - 1));
+	}
+
+	size_t sets;
+	unique_ptr<Entry[]> entries;
+	vector<uint8_t> hands;
+	vector<mutex> locks;
+
+};
+
+/* The result cache of the streaming and server modes, created before the first query if not disabled */
+static unique_ptr<ResultCache> resultCache;
+
+/*
+* Parses one query of the streaming mode.
+* A query is either a list of values, or "ratio" followed by the ratio, both optionally followed by -err and the max. error (in percent).
+* A list of values preceded by "sweep" (or any list of values if the sweep option is set) lists the series for a range of tolerances instead.
+* A list of values preceded by "minimize" (or any list of values if the minimize option is set) chooses the fewest distinct parts for them instead.
+* A list of values preceded by "chain" (or any list of values if the chain option is set) are the taps of a ladder to build instead.
+* Ratios can be followed by -top and the number of pairs to list, ranked across all series.
+* "network" followed by the ratio (or any ratio if the network option is set) searches networks of up to four values for the ratio.
+* Ratios can also be followed by -yield and the number of samples to simulate the spread of the found pair with.
+* @param begin The start of the query text
+* @param end The end of the query text
+* @param options The settings used if the query does not specify them
+* @param query Returns the parsed query, its buffers are reused
+*/
+void parseQuery(const char* begin, const char* end, const QueryOptions& options, Query& query) {
+
+	query.stats = QueryStats();
+	StageTimer timer = StageTimer(query.stats.parseTime);
+
+	query.values.clear();
+	query.maxError = options.maxError;
+	query.top = options.top;
+	query.stock = options.stock;
+	query.yieldSamples = options.yieldSamples;
+	query.partTolerance = options.partTolerance;
+	query.tempco = options.tempco;
+	query.kind = options.sweep ? QUERY_SWEEP : options.minimize ? QUERY_MINIMIZE : options.chain ? QUERY_CHAIN : QUERY_VALUES;
+
+	const char* c = begin;
+	bool readError = false;
+	bool readTop = false;
+	bool readYield = false;
+	while (c != end) {
+		while (c != end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == ',' || *c == ';')) c++;
+		if (c == end) break;
+		const char* token = c;
+		while (c != end && *c != ' ' && *c != '\t' && *c != '\r' && *c != ',' && *c != ';') c++;
+		size_t length = c - token;
+
+		double value;
+		if ((length == 5 && strncmp(token, "ratio", 5) == 0) || (length == 6 && strncmp(token, "-ratio", 6) == 0)) {
+			query.kind = options.network ? QUERY_NETWORK : QUERY_RATIO;
+		} else if ((length == 7 && strncmp(token, "network", 7) == 0) || (length == 8 && strncmp(token, "-network", 8) == 0)) {
+			query.kind = QUERY_NETWORK;
+		} else if ((length == 5 && strncmp(token, "sweep", 5) == 0) || (length == 7 && strncmp(token, "--sweep", 7) == 0)) {
+			query.kind = QUERY_SWEEP;
+		} else if ((length == 8 && strncmp(token, "minimize", 8) == 0) || (length == 16 && strncmp(token, "--minimize-parts", 16) == 0)) {
+			query.kind = QUERY_MINIMIZE;
+		} else if ((length == 5 && strncmp(token, "chain", 5) == 0) || (length == 7 && strncmp(token, "--chain", 7) == 0)) {
+			query.kind = QUERY_CHAIN;
+		} else if (length == 4 && strncmp(token, "-err", 4) == 0) {
+			readError = true;
+		} else if (length == 4 && strncmp(token, "-top", 4) == 0) {
+			readTop = true;
+		} else if ((length == 6 && strncmp(token, "-yield", 6) == 0) || (length == 7 && strncmp(token, "--yield", 7) == 0)) {
+			readYield = true;
+		} else if (!parseValue(token, c, &value)) {
+			query.kind = QUERY_INVALID;
+			return;
+		} else if (readError) {
+			query.maxError = value / 100.0;
+			readError = false;
+		} else if (readTop) {
+			if (value < 0.0 || value > MAX_TOP) {
+				query.kind = QUERY_INVALID;
+				return;
+			}
+			query.top = (unsigned) value;
+			readTop = false;
+		} else if (readYield) {
+			if (value < 0.0 || value > MAX_YIELD) {
+				query.kind = QUERY_INVALID;
+				return;
+			}
+			query.yieldSamples = (uint64_t) value;
+			readYield = false;
+		} else {
+			query.values.push_back(value);
+		}
+	}
+
+	if (query.values.empty()) query.kind = QUERY_EMPTY;
+
+}
+
+/*
+* Returns the key of a mantissa in the result cache, rounded to 12 digits the same way the solver rounds the values.
+* The same mantissa taken from different decades (0.47, 47, 4700) can differ in the last bit, the rounding makes them share one entry.
+* @param mantissa The value or ratio transformed to 1.0 - 10.0
+* @returns The key, or zero if the mantissa rounds up to the next decade and is not cached
+*/
+double cacheKey(double mantissa) {
+	double key = round(mantissa * 1e12) / 1e12;
+	return key < 10.0 ? key : 0.0;
+}
+
+/*
+* Answers a ratio query through the result cache.
+* The cache holds the pair the solver finds for the key of the ratio, one of the values is then moved into the ratio's decade like the
+* solver does, and the error is taken against the ratio itself, so that it is exact for every query sharing the entry.
+* Of two pairs that tie within the 12 digits of the key, the one for the key is reported, which need not be the one for the unrounded ratio.
+*/
+int matchRatioCached(Query& query) {
+	int exponent;
+	double r = cutDown(query.values[0], &exponent);
+	double key = cacheKey(r);
+	if (key == 0.0) return solver.matchRatio(query.values[0], query.maxError, &query.error, &query.value1, &query.value2);
+
+	CacheResult result = { 0, 0.0, 0.0, 0.0 };
+	query.stats.cacheLookups++;
+	if (resultCache->find(CACHE_RATIO, key, query.maxError, &result)) {
+		query.stats.cacheHits++;
+	} else {
+		result.series = (uint16_t) solver.matchRatio(key, query.maxError, &result.error, &result.value1, &result.value2);
+		resultCache->store(CACHE_RATIO, key, query.maxError, result);
+	}
+
+	if (result.series == 0) return 0;
+	query.error = abs(result.value1 / result.value2 - r) / r;
+	query.value1 = exponent >= 0 ? scaleDecade(result.value1, exponent) : result.value1;
+	query.value2 = exponent >= 0 ? result.value2 : scaleDecade(result.value2, -exponent);
+	return result.series;
+}
+
+/*
+* Answers a query of a single value through the result cache, the same way as matchRatioCached.
+* The key of the value is matched on its own, the solver rounds the value to the same mantissa, which gives the series value in
+* 1.0 - 10.0 that is then moved into the value's decade.
+*/
+int matchValueCached(Query& query, ESeriesSolver::Workspace& workspace) {
+	int exponent;
+	double key = cacheKey(cutDown(query.values[0], &exponent));
+	if (key == 0.0) return solver.matchValues(query.values, query.maxError, query.matches, workspace, &query.error);
+
+	CacheResult result = { 0, 0.0, 0.0, 0.0 };
+	query.stats.cacheLookups++;
+	if (resultCache->find(CACHE_VALUE, key, query.maxError, &result)) {
+		query.stats.cacheHits++;
+	} else {
+		ValueMatch match = ValueMatch();
+		result.series = (uint16_t) solver.matchValues(span<const double>(&key, 1), query.maxError, span<ValueMatch>(&match, 1), workspace, &result.error);
+		result.value1 = match.seriesValue;
+		result.value2 = match.mantissa;
+		resultCache->store(CACHE_VALUE, key, query.maxError, result);
+	}
+
+	query.error = result.error;
+	if (result.series != 0) query.matches[0] = { query.values[0], result.value2, scaleDecade(result.value1, exponent), result.error };
+	return result.series;
+}
+
+/*
+* Runs the search for a parsed query, and stores the result in it.
+*/
+void solveQuery(Query& query) {
+
+	static thread_local ESeriesSolver::Workspace workspace = ESeriesSolver::Workspace();
+	StageTimer timer = StageTimer(query.stats.solveTime);
+	WorkCounter counter = WorkCounter(query.stats.solver);
+
+	query.series = 0;
+	query.error = 0.0;
+	query.yield.samples = 0;
+
+	// The inventory answers value and ratio queries on its own, with the single best result
+	if (query.stock != nullptr && query.kind == QUERY_VALUES) {
+		query.matches.resize(query.values.size());
+		query.series = query.stock->matchValues(query.values, query.maxError, query.matches, &query.error) ? STOCK_SERIES : 0;
+	} else if (query.stock != nullptr && query.kind == QUERY_RATIO) {
+		query.ranked.clear();
+		query.series = query.stock->matchRatio(query.values[0], query.maxError, &query.error, &query.value1, &query.value2) ? STOCK_SERIES : 0;
+	} else if (query.kind == QUERY_RATIO && query.top > 0) {
+		query.ranked.resize(query.top);
+		query.ranked.resize(solver.matchRatios(query.values[0], query.maxError, query.ranked));
+		if (!query.ranked.empty()) {
+			const RatioMatch& best = query.ranked[0];
+			query.series = best.series;
+			query.error = best.error;
+			query.value1 = best.value1;
+			query.value2 = best.value2;
+		}
+	} else if (query.kind == QUERY_RATIO && resultCache != nullptr) {
+		query.ranked.clear();
+		query.series = matchRatioCached(query);
+	} else if (query.kind == QUERY_RATIO) {
+		query.ranked.clear();
+		query.series = solver.matchRatio(query.values[0], query.maxError, &query.error, &query.value1, &query.value2);
+	} else if (query.kind == QUERY_VALUES && query.values.size() == 1 && resultCache != nullptr) {
+		query.matches.resize(1);
+		query.series = matchValueCached(query, workspace);
+	} else if (query.kind == QUERY_VALUES) {
+		query.matches.resize(query.values.size());
+		query.series = solver.matchValues(query.values, query.maxError, query.matches, workspace, &query.error);
+	} else if (query.kind == QUERY_SWEEP) {
+		query.profile.resize(solver.seriesCount());
+		solver.errorProfile(query.values, query.profile, workspace);
+	} else if (query.kind == QUERY_NETWORK) {
+		query.series = solver.matchNetwork(query.values[0], query.maxError, &query.network);
+		query.error = query.network.error;
+	} else if (query.kind == QUERY_MINIMIZE) {
+		query.matches.resize(query.values.size());
+		query.series = solver.minimizeParts(query.values, query.maxError, query.matches, workspace, &query.parts, &query.error);
+	} else if (query.kind == QUERY_CHAIN) {
+		query.matches.resize(query.values.size());
+		query.resistors.resize(query.values.size() + 1);
+		query.series = solver.matchChain(query.values, query.maxError, query.resistors, query.matches, workspace, &query.parts, &query.error);
+	}
 
-using namespace std;
+}
 
-/* For historical reasons, these E-series do not match the actual equation, and need to be defined by fixed values */
-static const double E3[] = {1.0, 2.2, 4.7};
-static const double E6[] = {1.0, 1.5, 2.2, 3.3, 4.7, 6.8};
-static const double E12[] = {1.0, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2};
-static const double E24[] = {1.0, 1.1, 1.2, 1.3, 1.5, 1.6, 1.8, 2.0, 2.2, 2.4, 2.7, 3.0, 3.3, 3.6, 3.9, 4.3, 4.7, 5.1, 5.6, 6.2, 6.8, 7.5, 8.2, 9.1};
+/*
+* Writes one half of a network, as the value or as (value1+value2) for series and (value1||value2) for parallel values.
+*/
+void writeNetworkHalf(OutputBuffer& output, const NetworkHalf& half) {
+	if (half.branch == BRANCH_SINGLE) {
+		output.writeNumber(half.value1);
+		return;
+	}
+	output.write('(');
+	output.writeNumber(half.value1);
+	output.write(half.branch == BRANCH_SERIES ? "+" : "||");
+	output.writeNumber(half.value2);
+	output.write(')');
+}
 
 /*
-* Transforms a value passed into a value in the range 0.0 - 10.0
-* Example: 0.00456 -> 4.56	12300 -> 1.23
+* Reads the values of an inventory or series file, the first value of every line is used, so that lines can carry part numbers or other columns after it.
+* Empty lines, lines starting with # and lines without a value are skipped.
+* @param path The path of the file
+* @param values Returns the values
+* @returns false if the file could not be opened
 */
-double cutDown(double d) {
-	if (d < 1.0)
-		while (d < 1.0) d *= 10;
-	else
-		while (d > 10.0) d /= 10;
-	return d;
+bool loadStock(const char* path, vector<double>* values) {
+
+	ifstream file = ifstream(path);
+	if (!file.is_open()) return false;
+
+	string line;
+	while (getline(file, line)) {
+		const char* c = line.data();
+		const char* end = line.data() + line.size();
+		while (c != end && (*c == ' ' || *c == '\t')) c++;
+		if (c == end || *c == '#') continue;
+
+		while (c != end) {
+			const char* token = c;
+			while (c != end && *c != ' ' && *c != '\t' && *c != '\r' && *c != ',' && *c != ';') c++;
+			double value;
+			if (parseValue(token, c, &value)) {
+				values->push_back(value);
+				break;
+			}
+			while (c != end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == ',' || *c == ';')) c++;
+		}
+	}
+	return true;
+
 }
 
 /*
-* Tries to find the first E-series, from which values the requested ratio can be made, while stayng below the requested maximal error.
-* @param ratio The ratio of the two values
-* @param maxError The maximum error that is acceptable
-* @param error The actual error with the found values
-* @param value1 The first value from the found series
-* @param value2 The second value from the found series
-* @returns The series from which the values where taken
+* Formats the results of solved queries, the queries are numbered by their line in the input.
 */
-int findEseriesForRatio(double ratio, double maxError, double* error, double* value1, double* value2) {
-	
-	if (maxError <= 0.0) return 0;
-	
-	double r = cutDown(ratio);
-	for (uint16_t n = 3; (uint32_t) n * 2 < 0xFFFF; n *= 2) {
-		
-		for (uint16_t e1 = 1; e1 <= n; e1++) {
-			for (uint16_t e2 = 1; e2 <= e1; e2++) {
-				
-				const double* ser;
-				switch (n) {
-					case 3:
-						ser = E3;
-						goto fix_series;
-					case 6:
-						ser = E6;
-						goto fix_series;
-					case 12:
-						ser = E12;
-						goto fix_series;
-					case 24:
-						ser = E24;
-						goto fix_series;
-
-					fix_series:
-						*value1 = ser[e1];
-						*value2 = ser[e2];
-						break;
-						
-					default:
-						double r10 = pow(10, 1.0 / n);
-						*value1 = round(pow(r10, e1) * 1000.0) / 1000.0;
-						*value2 = round(pow(r10, e2) * 1000.0) / 1000.0;
-						break;
-				}
-				
-				double rat = *value1 / *value2;
-				double err = abs(rat - r) / r;
-				
-				if (err <= maxError) {
-					*error = err;
-					while (*value1 / *value2 < ratio) *value1 *= 10;
-					while (*value1 / *value2 > ratio) *value2 *= 10;
-					return n;
+class ResultWriter {
+
+public:
+	ResultWriter(OutputBuffer& output) : output(output) {}
+	virtual ~ResultWriter() {}
+
+	virtual void begin() {}
+	virtual void write(size_t number, const Query& query) = 0;
+
+protected:
+	OutputBuffer& output;
+
+};
+
+/*
+* Plain text, one line per query with the series, the error (in percent) and the found values, or "none" / "invalid".
+* Results from the inventory have the series "stock".
+* Sweeps list the series for each tolerance (in percent) as tolerance:series, ranked ratio pairs are separated by " | ".
+* Networks are written as upper/lower, with (value1+value2) for series and (value1||value2) for parallel values.
+* Minimized parts have the number of distinct parts between the series and the error, followed by the part for each value.
+* Ladders are written the same way, with the number of distinct values, followed by the resistors from the top of the ladder down.
+* A yield analysis follows the ratio as yield:fraction within the max. error and p50:error up to p99.9:error, all in percent.
+*/
+class TextWriter : public ResultWriter {
+
+public:
+	TextWriter(OutputBuffer& output) : ResultWriter(output) {}
+
+	void write(size_t, const Query& query) override {
+		if (query.kind == QUERY_INVALID) {
+			output.write("invalid");
+		} else if (query.kind != QUERY_SWEEP && query.kind != QUERY_EMPTY && query.series == 0) {
+			output.write("none");
+		} else if (query.kind == QUERY_NETWORK) {
+			output.write('E');
+			output.writeNumber((uint64_t) query.series);
+			output.write(' ');
+			output.writeFixed(query.error * 100.0, 4);
+			output.write(' ');
+			writeNetworkHalf(output, query.network.upper);
+			output.write('/');
+			writeNetworkHalf(output, query.network.lower);
+		} else if (query.kind == QUERY_RATIO && !query.ranked.empty()) {
+			for (size_t i = 0; i < query.ranked.size(); i++) {
+				const RatioMatch& match = query.ranked[i];
+				if (i > 0) output.write(" | ");
+				writePair(match.series, match.error, match.value1, match.value2);
+			}
+			if (query.yield.samples > 0) writeYield(query.yield);
+		} else if (query.kind == QUERY_RATIO) {
+			writePair(query.series, query.error, query.value1, query.value2);
+			if (query.yield.samples > 0) writeYield(query.yield);
+		} else if (query.kind == QUERY_CHAIN) {
+			writeSeries(query.series);
+			output.write(' ');
+			output.writeNumber((uint64_t) query.parts);
+			output.write(' ');
+			output.writeFixed(query.error * 100.0, 4);
+			for (double resistor : query.resistors) {
+				output.write(' ');
+				output.writeNumber(resistor);
+			}
+		} else if (query.kind == QUERY_VALUES || query.kind == QUERY_MINIMIZE) {
+			writeSeries(query.series);
+			if (query.kind == QUERY_MINIMIZE) {
+				output.write(' ');
+				output.writeNumber((uint64_t) query.parts);
+			}
+			output.write(' ');
+			output.writeFixed(query.error * 100.0, 4);
+			for (const ValueMatch& match : query.matches) {
+				output.write(' ');
+				output.writeNumber(match.seriesValue);
+			}
+		} else if (query.kind == QUERY_SWEEP) {
+			for (double tolerance : SWEEP_TOLERANCES) {
+				int s = ESeriesSolver::seriesForError(query.profile, tolerance);
+				if (tolerance != SWEEP_TOLERANCES[0]) output.write(' ');
+				output.writeNumber(tolerance * 100.0);
+				output.write(':');
+				if (s < 0) {
+					output.write("none");
+				} else {
+					output.write('E');
+					output.writeNumber((uint64_t) query.profile[s].series);
 				}
-				
 			}
 		}
-		
+		output.write('\n');
+	}
+
+private:
+	void writeSeries(uint16_t series) {
+		if (series == STOCK_SERIES) {
+			output.write("stock");
+			return;
+		}
+		output.write('E');
+		output.writeNumber((uint64_t) series);
+	}
+
+	void writePair(uint16_t series, double error, double value1, double value2) {
+		writeSeries(series);
+		output.write(' ');
+		output.writeFixed(error * 100.0, 4);
+		output.write(' ');
+		output.writeNumber(value1);
+		output.write(' ');
+		output.writeNumber(value2);
+	}
+
+	void writeYield(const YieldResult& yield) {
+		output.write(" yield:");
+		output.writeFixed(yield.within * 100.0, 4);
+		for (size_t i = 0; i < size(YIELD_PERCENTILES); i++) {
+			output.write(" p");
+			output.writeNumber(YIELD_PERCENTILES[i] * 100.0);
+			output.write(':');
+			output.writeFixed(yield.percentiles[i] * 100.0, 4);
+		}
 	}
-	
-	return 0;
-	
-}
+
+};
 
 /*
-* Tries to find the first E-series, which's values are close to the provided values.
-* @param values The values to find a close E-series for
-* @param maxError The maximum error that is acceptable
-* @param largestError Returns the largest error that occurs in the best E-series found
-* @param seriesValues Returns a map that assigns each requested value (transformed to 0.0-10.0) the found E-series value
-* @returns The best series found, or zero if none matched the maximum error
+* CSV or TSV, one row per requested value (or ratio) with the columns query, kind, series, error (in percent), value, result1 and result2.
+* The series is "stock" for results from the inventory.
+* For values the result is the series value, for ratios the two values of the pair.
+* Sweeps have one row per tolerance, with the tolerance (in percent) as value and the largest error of the series as error.
+* Ranked ratio queries have one row per pair, best first. Networks have the upper and lower half as results, written as in the text format.
+* Minimized parts have the part as first and the number of distinct parts as second result.
+* Ladders have one row per tap, with the ratio the tap actually has as first and the number of distinct values as second result,
+* followed by one row per resistor from the top of the ladder down, with the position in the ladder as value and the resistor as first result.
+* A yield analysis adds one row per percentile after the ratio, with the percentile as value, the fraction within the max. error as first and the number of samples as second result.
 */
-int findEseries(vector<double>& values, double maxError, double* largestError, map<double, double>& seriesValues) {
+class DelimitedWriter : public ResultWriter {
 
-	if (maxError <= 0.0) return 0;
-	seriesValues.clear();
+public:
+	DelimitedWriter(OutputBuffer& output, char separator) : ResultWriter(output), separator(separator) {}
 
-	double error = 0.0;
-	uint16_t bestSeries = 0;
-	for (uint16_t n = 3; (uint32_t) n * 2 < 0xFFFF; n *= 2) {
-
-		*largestError = 0.0;
-		const double* ser;
-
-		switch (n) {
-		case 3:
-			ser = E3;
-			goto fix_series;
-		case 6:
-			ser = E6;
-			goto fix_series;
-		case 12:
-			ser = E12;
-			goto fix_series;
-		case 24:
-			ser = E24;
-			goto fix_series;
-
-		fix_series:
-			for (const auto value : values) {
-				double v = cutDown(value);
-				double smallestError = -1.0;
-				for (uint16_t m = 0; m < n; m++) {
-					double ve = ser[m];
-					double err = abs(ve - v) / v;
-
-					if (err < smallestError || smallestError < 0) {
-						smallestError = err;
-						seriesValues[v] = ve;
-					}
+	void begin() override {
+		const char* columns[] = { "query", "kind", "series", "error", "value", "result1", "result2" };
+		for (int i = 0; i < 7; i++) {
+			if (i > 0) output.write(separator);
+			output.write(columns[i]);
+		}
+		output.write('\n');
+	}
+
+	void write(size_t number, const Query& query) override {
+		if (query.kind == QUERY_EMPTY) return;
+
+		if (query.kind == QUERY_INVALID) {
+			writeRow(number, "invalid", query, nullptr);
+		} else if (query.kind == QUERY_RATIO && !query.ranked.empty()) {
+			for (const RatioMatch& match : query.ranked) writeRankedRow(number, query, match);
+			writeYieldRows(number, query);
+		} else if (query.kind == QUERY_RATIO) {
+			writeRow(number, "ratio", query, nullptr);
+			writeYieldRows(number, query);
+		} else if (query.kind == QUERY_SWEEP) {
+			for (double tolerance : SWEEP_TOLERANCES) writeSweepRow(number, query, tolerance);
+		} else if (query.kind == QUERY_NETWORK) {
+			writeNetworkRow(number, query);
+		} else if (query.kind == QUERY_MINIMIZE) {
+			for (size_t i = 0; i < query.values.size(); i++) writeRow(number, "minimize", query, query.series != 0 ? &query.matches[i] : nullptr, i);
+		} else if (query.kind == QUERY_CHAIN) {
+			for (size_t i = 0; i < query.values.size(); i++) writeRow(number, "chain", query, query.series != 0 ? &query.matches[i] : nullptr, i);
+			for (size_t i = 0; query.series != 0 && i < query.resistors.size(); i++) writeResistorRow(number, query, i);
+		} else if (query.series == 0) {
+			for (size_t i = 0; i < query.values.size(); i++) writeRow(number, "value", query, nullptr, i);
+		} else {
+			for (size_t i = 0; i < query.values.size(); i++) writeRow(number, "value", query, &query.matches[i], i);
+		}
+	}
+
+private:
+	char separator;
+
+	void writeRow(size_t number, const char* kind, const Query& query, const ValueMatch* match, size_t value = 0) {
+		output.writeNumber((uint64_t) number);
+		output.write(separator);
+		output.write(kind);
+		output.write(separator);
+		bool found = query.kind != QUERY_INVALID && query.series != 0;
+		if (query.series == STOCK_SERIES) {
+			output.write("stock");
+		} else if (query.kind != QUERY_INVALID) {
+			output.writeNumber((uint64_t) query.series);
+		}
+		output.write(separator);
+		if (found) output.writeNumber((match != nullptr ? match->error : query.error) * 100.0);
+		output.write(separator);
+		if (query.kind != QUERY_INVALID) output.writeNumber(query.values[value]);
+		output.write(separator);
+		if (found) output.writeNumber(match != nullptr ? match->seriesValue : query.value1);
+		output.write(separator);
+		if (found && match == nullptr) output.writeNumber(query.value2);
+		if (found && (query.kind == QUERY_MINIMIZE || query.kind == QUERY_CHAIN)) output.writeNumber((uint64_t) query.parts);
+		output.write('\n');
+	}
+
+	void writeRankedRow(size_t number, const Query& query, const RatioMatch& match) {
+		output.writeNumber((uint64_t) number);
+		output.write(separator);
+		output.write("ratio");
+		output.write(separator);
+		output.writeNumber((uint64_t) match.series);
+		output.write(separator);
+		output.writeNumber(match.error * 100.0);
+		output.write(separator);
+		output.writeNumber(query.values[0]);
+		output.write(separator);
+		output.writeNumber(match.value1);
+		output.write(separator);
+		output.writeNumber(match.value2);
+		output.write('\n');
+	}
+
+	void writeNetworkRow(size_t number, const Query& query) {
+		output.writeNumber((uint64_t) number);
+		output.write(separator);
+		output.write("network");
+		output.write(separator);
+		output.writeNumber((uint64_t) query.series);
+		output.write(separator);
+		if (query.series != 0) output.writeNumber(query.error * 100.0);
+		output.write(separator);
+		output.writeNumber(query.values[0]);
+		output.write(separator);
+		if (query.series != 0) writeNetworkHalf(output, query.network.upper);
+		output.write(separator);
+		if (query.series != 0) writeNetworkHalf(output, query.network.lower);
+		output.write('\n');
+	}
+
+	void writeResistorRow(size_t number, const Query& query, size_t position) {
+		output.writeNumber((uint64_t) number);
+		output.write(separator);
+		output.write("resistor");
+		output.write(separator);
+		output.writeNumber((uint64_t) query.series);
+		output.write(separator);
+		output.write(separator);
+		output.writeNumber((uint64_t) position + 1);
+		output.write(separator);
+		output.writeNumber(query.resistors[position]);
+		output.write(separator);
+		output.write('\n');
+	}
+
+	void writeYieldRows(size_t number, const Query& query) {
+		if (query.yield.samples == 0) return;
+		for (size_t i = 0; i < size(YIELD_PERCENTILES); i++) {
+			output.writeNumber((uint64_t) number);
+			output.write(separator);
+			output.write("yield");
+			output.write(separator);
+			if (query.series == STOCK_SERIES) {
+				output.write("stock");
+			} else {
+				output.writeNumber((uint64_t) query.series);
+			}
+			output.write(separator);
+			output.writeNumber(query.yield.percentiles[i] * 100.0);
+			output.write(separator);
+			output.writeNumber(YIELD_PERCENTILES[i] * 100.0);
+			output.write(separator);
+			output.writeNumber(query.yield.within * 100.0);
+			output.write(separator);
+			output.writeNumber(query.yield.samples);
+			output.write('\n');
+		}
+	}
+
+	void writeSweepRow(size_t number, const Query& query, double tolerance) {
+		int s = ESeriesSolver::seriesForError(query.profile, tolerance);
+		output.writeNumber((uint64_t) number);
+		output.write(separator);
+		output.write("sweep");
+		output.write(separator);
+		output.writeNumber((uint64_t) (s < 0 ? 0 : query.profile[s].series));
+		output.write(separator);
+		if (s >= 0) output.writeNumber(query.profile[s].largestError * 100.0);
+		output.write(separator);
+		output.writeNumber(tolerance * 100.0);
+		output.write(separator);
+		output.write(separator);
+		output.write('\n');
+	}
+
+};
+
+/*
+* JSON lines, one object per query.
+* Value queries: {"query":1,"kind":"values","series":12,"error":2.44,"matches":[{"value":1230,"series_value":1200,"error":2.44}]}
+* Ratio queries: {"query":2,"kind":"ratio","ratio":3.3,"series":6,"error":0,"value1":3.3,"value2":1}
+* Ranked ratio queries also list all pairs: ..."value2":1,"ranked":[{"series":6,"error":0,"value1":3.3,"value2":1},...]}
+* Networks: {"query":4,"kind":"network","ratio":3.14,"series":3,"error":0.17,"upper":{"branch":"single","values":[4.7]},"lower":{"branch":"parallel","values":[2.2,4.7]}}
+* A yield analysis adds to ratio queries: ..."yield":{"samples":1000000,"tolerance":5,"within":97.3,"largest_error":1.2,"percentiles":[{"percentile":50,"error":0.4},...]}}
+* Ladders: {"query":6,"kind":"chain","series":24,"error":0.46,"distinct":2,"resistors":[2.2,2.2,3.3],"taps":[{"tap":0.6,"ratio":0.6,"error":0},...]}, resistors from the top down
+* Minimized parts: {"query":5,"kind":"minimize","series":12,"error":4.35,"parts":2,"matches":[...]}, with the matches as for values
+* Sweeps: {"query":3,"kind":"sweep","profile":[{"series":3,"error":37.5},...],"sweep":[{"tolerance":0.05,"series":3072},...]}
+* Queries without a matching series have a series of 0, results from the inventory have the series "stock", the errors are in percent.
+*/
+class JsonWriter : public ResultWriter {
+
+public:
+	JsonWriter(OutputBuffer& output) : ResultWriter(output) {}
+
+	void write(size_t number, const Query& query) override {
+		if (query.kind == QUERY_EMPTY) return;
+
+		output.write("{\"query\":");
+		output.writeNumber((uint64_t) number);
+		if (query.kind == QUERY_INVALID) {
+			output.write(",\"kind\":\"invalid\"}\n");
+			return;
+		}
+
+		if (query.kind == QUERY_SWEEP) {
+			writeSweep(query);
+			return;
+		}
+
+		if (query.kind == QUERY_RATIO) {
+			output.write(",\"kind\":\"ratio\",\"ratio\":");
+			output.writeNumber(query.values[0]);
+		} else if (query.kind == QUERY_NETWORK) {
+			output.write(",\"kind\":\"network\",\"ratio\":");
+			output.writeNumber(query.values[0]);
+		} else if (query.kind == QUERY_MINIMIZE) {
+			output.write(",\"kind\":\"minimize\"");
+		} else if (query.kind == QUERY_CHAIN) {
+			output.write(",\"kind\":\"chain\"");
+		} else {
+			output.write(",\"kind\":\"values\"");
+		}
+		output.write(",\"series\":");
+		if (query.series == STOCK_SERIES) {
+			output.write("\"stock\"");
+		} else {
+			output.writeNumber((uint64_t) query.series);
+		}
+
+		if (query.series != 0) {
+			output.write(",\"error\":");
+			output.writeNumber(query.error * 100.0);
+			if (query.kind == QUERY_RATIO) {
+				output.write(",\"value1\":");
+				output.writeNumber(query.value1);
+				output.write(",\"value2\":");
+				output.writeNumber(query.value2);
+				if (!query.ranked.empty()) writeRanked(query);
+				if (query.yield.samples > 0) writeYield(query.yield);
+			} else if (query.kind == QUERY_NETWORK) {
+				output.write(",\"upper\":");
+				writeHalf(query.network.upper);
+				output.write(",\"lower\":");
+				writeHalf(query.network.lower);
+			} else if (query.kind == QUERY_CHAIN) {
+				writeChain(query);
+			} else {
+				if (query.kind == QUERY_MINIMIZE) {
+					output.write(",\"parts\":");
+					output.writeNumber((uint64_t) query.parts);
 				}
-				if (smallestError > *largestError) {
-					*largestError = smallestError;
+				output.write(",\"matches\":[");
+				for (size_t i = 0; i < query.matches.size(); i++) {
+					const ValueMatch& match = query.matches[i];
+					output.write(i > 0 ? ",{\"value\":" : "{\"value\":");
+					output.writeNumber(match.original);
+					output.write(",\"series_value\":");
+					output.writeNumber(match.seriesValue);
+					output.write(",\"error\":");
+					output.writeNumber(match.error * 100.0);
+					output.write('}');
 				}
+				output.write(']');
 			}
-			break;
+		}
+		output.write("}\n");
+	}
+
+private:
+	void writeHalf(const NetworkHalf& half) {
+		const char* branches[] = { "single", "series", "parallel" };
+		output.write("{\"branch\":\"");
+		output.write(branches[half.branch]);
+		output.write("\",\"values\":[");
+		output.writeNumber(half.value1);
+		if (half.branch != BRANCH_SINGLE) {
+			output.write(',');
+			output.writeNumber(half.value2);
+		}
+		output.write("]}");
+	}
+
+	void writeChain(const Query& query) {
+		output.write(",\"distinct\":");
+		output.writeNumber((uint64_t) query.parts);
+		output.write(",\"resistors\":[");
+		for (size_t i = 0; i < query.resistors.size(); i++) {
+			if (i > 0) output.write(',');
+			output.writeNumber(query.resistors[i]);
+		}
+		output.write("],\"taps\":[");
+		for (size_t i = 0; i < query.matches.size(); i++) {
+			const ValueMatch& match = query.matches[i];
+			output.write(i > 0 ? ",{\"tap\":" : "{\"tap\":");
+			output.writeNumber(match.original);
+			output.write(",\"ratio\":");
+			output.writeNumber(match.seriesValue);
+			output.write(",\"error\":");
+			output.writeNumber(match.error * 100.0);
+			output.write('}');
+		}
+		output.write(']');
+	}
+
+	void writeRanked(const Query& query) {
+		output.write(",\"ranked\":[");
+		for (size_t i = 0; i < query.ranked.size(); i++) {
+			const RatioMatch& match = query.ranked[i];
+			output.write(i > 0 ? ",{\"series\":" : "{\"series\":");
+			output.writeNumber((uint64_t) match.series);
+			output.write(",\"error\":");
+			output.writeNumber(match.error * 100.0);
+			output.write(",\"value1\":");
+			output.writeNumber(match.value1);
+			output.write(",\"value2\":");
+			output.writeNumber(match.value2);
+			output.write('}');
+		}
+		output.write(']');
+	}
+
+	void writeYield(const YieldResult& yield) {
+		output.write(",\"yield\":{\"samples\":");
+		output.writeNumber(yield.samples);
+		output.write(",\"tolerance\":");
+		output.writeNumber(yield.tolerance * 100.0);
+		output.write(",\"within\":");
+		output.writeNumber(yield.within * 100.0);
+		output.write(",\"largest_error\":");
+		output.writeNumber(yield.largestError * 100.0);
+		output.write(",\"percentiles\":[");
+		for (size_t i = 0; i < size(YIELD_PERCENTILES); i++) {
+			output.write(i > 0 ? ",{\"percentile\":" : "{\"percentile\":");
+			output.writeNumber(YIELD_PERCENTILES[i] * 100.0);
+			output.write(",\"error\":");
+			output.writeNumber(yield.percentiles[i] * 100.0);
+			output.write('}');
+		}
+		output.write("]}");
+	}
 
-		default:
-			double r10 = pow(10, 1.0 / n);
-			for (const auto value : values) {
-				double v = cutDown(value);
-				uint16_t m = round(log(v) / log(r10));
-				double ve = round(pow(r10, m) * 1000.0) / 1000.0;
-				double err = abs(ve - v) / v;
+	void writeSweep(const Query& query) {
+		output.write(",\"kind\":\"sweep\",\"profile\":[");
+		for (size_t s = 0; s < query.profile.size(); s++) {
+			output.write(s > 0 ? ",{\"series\":" : "{\"series\":");
+			output.writeNumber((uint64_t) query.profile[s].series);
+			output.write(",\"error\":");
+			output.writeNumber(query.profile[s].largestError * 100.0);
+			output.write('}');
+		}
+		output.write("],\"sweep\":[");
+		for (double tolerance : SWEEP_TOLERANCES) {
+			int s = ESeriesSolver::seriesForError(query.profile, tolerance);
+			output.write(tolerance != SWEEP_TOLERANCES[0] ? ",{\"tolerance\":" : "{\"tolerance\":");
+			output.writeNumber(tolerance * 100.0);
+			output.write(",\"series\":");
+			output.writeNumber((uint64_t) (s < 0 ? 0 : query.profile[s].series));
+			output.write('}');
+		}
+		output.write("]}\n");
+	}
+
+};
+
+enum OutputFormat {
+	FORMAT_BOX,
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_TSV,
+	FORMAT_JSON
+};
+
+/*
+* Creates the result writer for one of the machine readable output formats.
+*/
+unique_ptr<ResultWriter> createWriter(OutputFormat format, OutputBuffer& output) {
+	switch (format) {
+		case FORMAT_CSV: return make_unique<DelimitedWriter>(output, ',');
+		case FORMAT_TSV: return make_unique<DelimitedWriter>(output, '\t');
+		case FORMAT_JSON: return make_unique<JsonWriter>(output);
+		default: return make_unique<TextWriter>(output);
+	}
+}
+
+/*
+* Thread pool in which every worker owns a queue of work chunks, idle workers steal chunks from the back of the other queues.
+*/
+class WorkStealingPool {
+
+public:
+	WorkStealingPool(unsigned threads) : body(nullptr), generation(0), remaining(0), stop(false) {
+		for (unsigned i = 0; i < threads; i++) {
+			queues.push_back(make_unique<WorkQueue>());
+		}
+		for (unsigned i = 0; i < threads; i++) {
+			workers.emplace_back(&WorkStealingPool::run, this, i);
+		}
+	}
+
+	~WorkStealingPool() {
+		{
+			lock_guard<mutex> lock(stateLock);
+			stop = true;
+		}
+		wake.notify_all();
+		for (thread& worker : workers) worker.join();
+	}
+
+	/*
+	* Runs the body for all indices in [0, count), split into chunks which are distributed over the workers, and waits for all of them to finish.
+	* @param count The number of indices
+	* @param chunk The number of indices per chunk
+	* @param function The body, called with the first and one past the last index of a chunk
+	*/
+	void parallelFor(size_t count, size_t chunk, const function<void(size_t, size_t)>& function) {
+		if (count == 0) return;
+
+		unique_lock<mutex> lock(stateLock);
+		body = &function;
+		remaining = (count + chunk - 1) / chunk;
+		for (size_t begin = 0, i = 0; begin < count; begin += chunk, i++) {
+			WorkQueue& queue = *queues[i % queues.size()];
+			lock_guard<mutex> queueLock(queue.lock);
+			queue.chunks.push_back({ begin, min(begin + chunk, count) });
+		}
+		generation++;
+		wake.notify_all();
+		done.wait(lock, [this]() { return remaining == 0; });
+		body = nullptr;
+	}
 
-				seriesValues[v] = ve;
+private:
+	struct WorkQueue {
+		mutex lock;
+		deque<pair<size_t, size_t>> chunks;
+	};
 
-				if (err > *largestError) {
-					*largestError = err;
+	vector<unique_ptr<WorkQueue>> queues;
+	vector<thread> workers;
+	const function<void(size_t, size_t)>* body;
+	mutex stateLock;
+	condition_variable wake;
+	condition_variable done;
+	size_t generation;
+	atomic<size_t> remaining;
+	bool stop;
+
+	/*
+	* Takes the next chunk from the own queue, or steals one from another worker.
+	*/
+	bool take(unsigned id, pair<size_t, size_t>& chunk) {
+		for (size_t i = 0; i < queues.size(); i++) {
+			WorkQueue& queue = *queues[(id + i) % queues.size()];
+			lock_guard<mutex> lock(queue.lock);
+			if (queue.chunks.empty()) continue;
+			if (i == 0) {
+				chunk = queue.chunks.front();
+				queue.chunks.pop_front();
+			} else {
+				chunk = queue.chunks.back();
+				queue.chunks.pop_back();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void run(unsigned id) {
+		size_t seen = 0;
+		while (true) {
+			{
+				unique_lock<mutex> lock(stateLock);
+				wake.wait(lock, [&]() { return stop || generation != seen; });
+				if (stop) return;
+				seen = generation;
+			}
+
+			pair<size_t, size_t> chunk;
+			while (take(id, chunk)) {
+				(*body)(chunk.first, chunk.second);
+				if (--remaining == 0) {
+					lock_guard<mutex> lock(stateLock);
+					done.notify_all();
 				}
 			}
-			break;
 		}
+	}
 
-		if (*largestError < maxError) {
-			bestSeries = n;
-			error = *largestError;
-			break;
+};
+
+/* Number of lines per batch of the streaming mode, and the number of batches in flight per worker */
+static constexpr size_t STREAM_BATCH = 1024;
+static constexpr size_t STREAM_SLOTS_PER_WORKER = 4;
+
+/*
+* Bounded ring of query batches, connecting the reader, the solving workers and the writer of the streaming mode.
+* The reader fills the slots in order, the workers claim the filled slots through an atomic counter, and the writer drains the solved slots in order.
+* A slot only becomes free again after it was written, which bounds the memory use and blocks the reader while the writer falls behind.
+* All hand-overs are lock-free, waiting threads block on the atomics.
+*/
+class BatchRing {
+
+public:
+	struct Batch {
+		vector<string> lines;
+		vector<Query> queries;
+		size_t count;
+	};
+
+	BatchRing(size_t capacity) : slots(capacity), produced(0), claimed(0) {
+		for (Slot& slot : slots) {
+			slot.state = SLOT_FREE;
+			slot.batch.lines.resize(STREAM_BATCH);
+			slot.batch.queries.resize(STREAM_BATCH);
+			slot.batch.count = 0;
 		}
-	
 	}
 
-	return bestSeries;
+	/*
+	* Reader: waits until the slot for the next batch is free again and returns it for filling.
+	*/
+	Batch& acquire(size_t sequence) {
+		Slot& slot = slots[sequence % slots.size()];
+		for (uint32_t state; (state = slot.state.load(memory_order_acquire)) != SLOT_FREE; ) {
+			slot.state.wait(state, memory_order_acquire);
+		}
+		return slot.batch;
+	}
 
-}
+	/*
+	* Reader: hands the filled batch over to the workers, or marks the end of the input if last is set.
+	*/
+	void publish(size_t sequence, bool last) {
+		if (last) {
+			produced.store(sequence | FINISHED, memory_order_release);
+		} else {
+			slots[sequence % slots.size()].state.store(SLOT_FILLED, memory_order_release);
+			produced.store(sequence + 1, memory_order_release);
+		}
+		produced.notify_all();
+	}
 
-void findBestForRatio(double ratio, double maxError) {
+	/*
+	* Workers: claims the next filled batch.
+	* @returns false once all batches have been claimed and the input has ended
+	*/
+	bool claim(size_t& sequence, Batch*& batch) {
+		size_t next = claimed.load(memory_order_relaxed);
+		while (true) {
+			size_t available = produced.load(memory_order_acquire);
+			if (next >= (available & ~FINISHED)) {
+				if (available & FINISHED) return false;
+				produced.wait(available, memory_order_acquire);
+				next = claimed.load(memory_order_relaxed);
+				continue;
+			}
+			if (claimed.compare_exchange_weak(next, next + 1, memory_order_relaxed)) break;
+		}
+		sequence = next;
+		batch = &slots[next % slots.size()].batch;
+		return true;
+	}
 
-	wprintf(L"╔═══════════════════════════════════════╗\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
-	wprintf(L"╟───────────────────────────────────────╢\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Atrying to find best E-series\n");
-	wprintf(L"╚═══════════════════════════════════════╝\n");
+	/*
+	* Workers: marks a claimed batch as solved.
+	*/
+	void solved(size_t sequence) {
+		Slot& slot = slots[sequence % slots.size()];
+		slot.state.store(SLOT_SOLVED, memory_order_release);
+		slot.state.notify_all();
+	}
 
-	double error = 0.0;
-	double value1 = 0.0;
-	double value2 = 0.0;
-	uint16_t series = findEseriesForRatio(ratio, maxError, &error, &value1, &value2);
+	/*
+	* Writer: waits until the batch with the sequence number is solved.
+	* @returns nullptr once the input has ended before this batch
+	*/
+	Batch* next(size_t sequence) {
+		while (true) {
+			size_t available = produced.load(memory_order_acquire);
+			if (sequence < (available & ~FINISHED)) break;
+			if (available & FINISHED) return nullptr;
+			produced.wait(available, memory_order_acquire);
+		}
+		Slot& slot = slots[sequence % slots.size()];
+		for (uint32_t state; (state = slot.state.load(memory_order_acquire)) != SLOT_SOLVED; ) {
+			slot.state.wait(state, memory_order_acquire);
+		}
+		return &slot.batch;
+	}
 
-	if (series == 0) {
+	/*
+	* Writer: returns a written batch to the reader.
+	*/
+	void release(size_t sequence) {
+		Slot& slot = slots[sequence % slots.size()];
+		slot.state.store(SLOT_FREE, memory_order_release);
+		slot.state.notify_all();
+	}
 
-		wprintf(L"╔═══════════════════════════════════════╗\n");
-		wprintf(L"║                                       ║\n");
-		wprintf(L"  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
-		wprintf(L"╚═══════════════════════════════════════╝\n");
+private:
+	enum SlotState : uint32_t {
+		SLOT_FREE,
+		SLOT_FILLED,
+		SLOT_SOLVED
+	};
 
-		return;
+	struct Slot {
+		atomic<uint32_t> state;
+		Batch batch;
+	};
+
+	static constexpr size_t FINISHED = (size_t) 1 << (sizeof(size_t) * 8 - 1);
+
+	vector<Slot> slots;
+	atomic<size_t> produced;
+	atomic<size_t> claimed;
+
+};
+
+/*
+* Simulates the spread of the pair found for a solved ratio query, if the query asks for it, and stores the result in it.
+* The part tolerance defaults to the usual tolerance of the series of the pair.
+* @param query The solved query
+* @param pool The thread pool to spread the samples over, or nullptr to simulate them on the calling thread
+*/
+void analyseYield(Query& query, WorkStealingPool* pool) {
+
+	query.yield.samples = 0;
+	if (query.kind != QUERY_RATIO || query.series == 0 || query.yieldSamples == 0) return;
+	StageTimer timer = StageTimer(query.stats.yieldTime);
+
+	double tolerance = query.partTolerance > 0.0 ? query.partTolerance : query.series == STOCK_SERIES ? STOCK_TOLERANCE : seriesTolerance(query.series);
+	YieldModel model = { query.values[0], query.value1, query.value2, tolerance, query.tempco, YIELD_TEMPERATURE, query.maxError, YIELD_SEED };
+	YieldAnalysis analysis = YieldAnalysis(model);
+	uint64_t samples = query.yieldSamples;
+
+	if (pool == nullptr) {
+		analysis.simulate(0, samples);
+	} else {
+		// Every chunk simulates its own samples, so merging them in any order gives the same histogram
+		mutex mergeLock;
+		size_t chunks = (size_t) ((samples + YIELD_CHUNK - 1) / YIELD_CHUNK);
+		pool->parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+			YieldAnalysis part = YieldAnalysis(model);
+			for (size_t i = begin; i < end; i++) {
+				part.simulate(i * YIELD_CHUNK, min(YIELD_CHUNK, samples - i * YIELD_CHUNK));
+			}
+			lock_guard<mutex> lock(mergeLock);
+			analysis.merge(part);
+		});
+	}
 
+	query.yield.samples = analysis.samples();
+	query.yield.tolerance = tolerance;
+	query.yield.within = analysis.within();
+	query.yield.largestError = analysis.largestError();
+	for (size_t i = 0; i < size(YIELD_PERCENTILES); i++) {
+		query.yield.percentiles[i] = analysis.percentile(YIELD_PERCENTILES[i]);
 	}
 
-	wprintf(L"╔═══════════════════════════════════════╗\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Aerror: \033[38;5;190m%.2lf %%\033[0m\n", error * 100.0);
-	wprintf(L"╟───────────────────────────────────────╢\n");
-	wprintf(L"║ R_1        ┆ R_2        ┆ ratio       ║\n");
+}
+
+/*
+* Runs the streaming mode, reading one query per line and writing the results in the requested format.
+* Reading, solving and writing run as a pipeline: a reader thread fills batches of lines, the workers of the pool parse and solve them, and a writer thread writes them in input order.
+* @param input The stream to read the queries from
+* @param options The settings used for queries that do not specify them
+* @param writer The writer for the results
+* @param pool The thread pool whose workers solve the queries
+* @param workers The number of workers of the pool
+* @param summary Collects the stats of the queries, or nullptr
+*/
+void runStream(istream& input, const QueryOptions& options, ResultWriter& writer, WorkStealingPool& pool, unsigned workers, StatsSummary* summary) {
+
+	BatchRing ring = BatchRing(STREAM_SLOTS_PER_WORKER * workers);
+
+	thread reader = thread([&]() {
+		for (size_t sequence = 0; ; sequence++) {
+			BatchRing::Batch& batch = ring.acquire(sequence);
+			batch.count = 0;
+			while (batch.count < STREAM_BATCH && getline(input, batch.lines[batch.count])) batch.count++;
+
+			if (batch.count == 0) {
+				ring.publish(sequence, true);
+				return;
+			}
+			ring.publish(sequence, false);
+		}
+	});
+
+	thread output = thread([&]() {
+		size_t number = 0;
+		writer.begin();
+		BatchRing::Batch* batch;
+		uint64_t writeTime = 0;
+		for (size_t sequence = 0; (batch = ring.next(sequence)) != nullptr; sequence++) {
+			StageTimer timer = StageTimer(writeTime);
+			for (size_t i = 0; i < batch->count; i++) {
+				writer.write(++number, batch->queries[i]);
+				if (summary != nullptr) summary->add(number, batch->queries[i].stats);
+			}
+			ring.release(sequence);
+		}
+		if (summary != nullptr) summary->writeTime += writeTime;
+	});
 
-	wprintf(L"║            ┆            ┆             ║\n");
-	wprintf(L"  \033[1A \033[38;5;76m%.3lf\033[0m\n", value1);
-	wprintf(L"               \033[1A \033[38;5;76m%.3lf\033[0m\n", value2);
-	wprintf(L"                            \033[1A \033[38;5;190m%.2lf\033[0m\n", value1 / value2);
+	pool.parallelFor(workers, 1, [&](size_t, size_t) {
+		size_t sequence;
+		BatchRing::Batch* batch;
+		while (ring.claim(sequence, batch)) {
+			for (size_t i = 0; i < batch->count; i++) {
+				const string& line = batch->lines[i];
+				parseQuery(line.data(), line.data() + line.size(), options, batch->queries[i]);
+				solveQuery(batch->queries[i]);
+				analyseYield(batch->queries[i], nullptr);
+			}
+			ring.solved(sequence);
+		}
+	});
 
-	wprintf(L"╚═══════════════════════════════════════╝\n");
+	reader.join();
+	output.join();
 
 }
 
-void findBestForValues(vector<double>& values, double maxError) {
+/*
+* Answers the queries of one client of the server mode, one result per query line, until the client disconnects.
+* The results of all complete lines received at once are sent together.
+* If the options ask for stats, the summary of the connection is written to stderr once the client disconnects.
+* @param receive Reads the next data from the client into the buffer, returns the number of bytes, or zero or less if the connection was closed
+* @param send Sends data to the client
+* @param options The settings used for queries that do not specify them
+* @param format The format of the results
+*/
+void serveClient(const function<ptrdiff_t(char*, size_t)>& receive, const function<void(const char*, size_t)>& send, QueryOptions options, OutputFormat format) {
 
-	wprintf(L"╔═══════════════════════════════════════╗\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Arequested max. error: \033[38;5;190m%.2lf %%\033[0m\n", maxError * 100.0);
-	wprintf(L"╟───────────────────────────────────────╢\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Atrying to find best E-series\n");
-	wprintf(L"╚═══════════════════════════════════════╝\n");
+	OutputBuffer output = OutputBuffer(send);
+	unique_ptr<ResultWriter> writer = createWriter(format, output);
+	Query query = Query();
+	size_t number = 0;
+	StatsSummary summary = StatsSummary();
 
-	double largestError = 0.0;
-	map<double, double> seriesValues = map<double, double>();
-	uint16_t series = findEseries(values, maxError, &largestError, seriesValues);
+	// The wall time is the time the client was connected
+	uint64_t connected = statsClock();
 
-	if (series == 0) {
+	writer->begin();
+	output.flush();
 
-		wprintf(L"╔═══════════════════════════════════════╗\n");
-		wprintf(L"║                                       ║\n");
-		wprintf(L"  \033[1A\033[38;5;196m[!] unabele to satisfy conditions\033[0m\n");
-		wprintf(L"╚═══════════════════════════════════════╝\n");
+	string pending = string();
+	char buffer[1 << 14];
+	while (true) {
+		ptrdiff_t received = receive(buffer, sizeof(buffer));
+		if (received <= 0) break;
+		pending.append(buffer, (size_t) received);
 
-		return;
+		size_t begin = 0;
+		for (size_t end; (end = pending.find('\n', begin)) != string::npos; begin = end + 1) {
+			parseQuery(pending.data() + begin, pending.data() + end, options, query);
+			solveQuery(query);
+			analyseYield(query, nullptr);
+			StageTimer timer = StageTimer(summary.writeTime);
+			writer->write(++number, query);
+			summary.add(number, query.stats);
+		}
+		pending.erase(0, begin);
+		StageTimer timer = StageTimer(summary.writeTime);
+		output.flush();
+	}
 
+	if (!pending.empty()) {
+		parseQuery(pending.data(), pending.data() + pending.size(), options, query);
+		solveQuery(query);
+		analyseYield(query, nullptr);
+		StageTimer timer = StageTimer(summary.writeTime);
+		writer->write(++number, query);
+		summary.add(number, query.stats);
 	}
 
-	wprintf(L"╔═══════════════════════════════════════╗\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Abest series: \033[38;5;76mE%u\033[0m\n", series);
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1Alargest error: \033[38;5;190m%.2lf %%\033[0m\n", largestError * 100.0);
-	wprintf(L"╟───────────────────────────────────────╢\n");
-	wprintf(L"║ R_orig     ┆ R_series   ┆ error       ║\n");
+	summary.wallTime = statsClock() - connected;
+	if (options.stats) summary.report(format != FORMAT_TEXT);
 
-	for (map<double, double>::iterator i = seriesValues.begin(); i != seriesValues.end(); i++) {
-	
-		double err = abs(i->second - i->first) / i->first;
+}
+
+/*
+* Runs the server mode, which answers queries from any number of clients, each connection is served by its own thread.
+* On windows the server listens on the named pipe \\.\pipe\<name>, otherwise on a unix socket with the name as path.
+* @param name The name of the pipe or the path of the socket
+* @param options The settings used for queries that do not specify them
+* @param format The format of the results
+* @returns Only returns if the server could not be started
+*/
+int runServer(const char* name, QueryOptions options, OutputFormat format) {
+
+#if defined(_WIN32)
+
+	string pipeName = string("\\\\.\\pipe\\") + name;
+	while (true) {
+		HANDLE pipe = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, PIPE_UNLIMITED_INSTANCES, 1 << 16, 1 << 16, 0, nullptr);
+		if (pipe == INVALID_HANDLE_VALUE) return -1;
+
+		if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+			CloseHandle(pipe);
+			continue;
+		}
+
+		thread([pipe, options, format]() {
+			serveClient([pipe](char* data, size_t length) -> ptrdiff_t {
+				DWORD read = 0;
+				if (!ReadFile(pipe, data, (DWORD) length, &read, nullptr)) return -1;
+				return read;
+			}, [pipe](const char* data, size_t length) {
+				DWORD written = 0;
+				WriteFile(pipe, data, (DWORD) length, &written, nullptr);
+			}, options, format);
+			FlushFileBuffers(pipe);
+			DisconnectNamedPipe(pipe);
+			CloseHandle(pipe);
+		}).detach();
+	}
 
-		wprintf(L"║            ┆            ┆             ║\n");
-		wprintf(L"  \033[1A \033[38;5;76m%.3lf\033[0m\n", i->first);
-		wprintf(L"               \033[1A \033[38;5;76m%.3lf\033[0m\n", i->second);
-		wprintf(L"                            \033[1A \033[38;5;190m%.2lf %%\033[0m\n", err * 100.0);
+#else
 
+	// Writing to a disconnected client should end its connection, not the server
+	signal(SIGPIPE, SIG_IGN);
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0) return -1;
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, name, sizeof(address.sun_path) - 1);
+	unlink(name);
+
+	if (bind(server, (sockaddr*) &address, sizeof(address)) != 0 || listen(server, 16) != 0) {
+		close(server);
+		return -1;
+	}
+
+	while (true) {
+		int client = accept(server, nullptr, nullptr);
+		if (client < 0) continue;
+
+		thread([client, options, format]() {
+			serveClient([client](char* data, size_t length) -> ptrdiff_t {
+				return recv(client, data, length, 0);
+			}, [client](const char* data, size_t length) {
+				while (length > 0) {
+					ssize_t sent = ::send(client, data, length, 0);
+					if (sent <= 0) return;
+					data += sent;
+					length -= (size_t) sent;
+				}
+			}, options, format);
+			close(client);
+		}).detach();
 	}
 
-	wprintf(L"╚═══════════════════════════════════════╝\n");
+#endif
 
 }
 
-int main(int argn, const char** argv) {
+/*
+* Prints the yield analysis of the best pair for a ratio, the samples are spread over all cores.
+*/
+void findYieldForRatio(double ratio, const QueryOptions& options) {
 
-	// Setting the terminal mode
-	_setmode(_fileno(stdout), _O_U16TEXT);
+	Query query = Query();
+	query.kind = QUERY_RATIO;
+	query.maxError = options.maxError;
+	query.yieldSamples = options.yieldSamples;
+	query.partTolerance = options.partTolerance;
+	query.tempco = options.tempco;
+	query.values = { ratio };
+	solveQuery(query);
+	if (query.series == 0) return;
+
+	WorkStealingPool pool = WorkStealingPool(max(thread::hardware_concurrency(), 1u));
+	analyseYield(query, &pool);
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Asimulated samples: \033[38;5;76m%llu\033[0m\n", (unsigned long long) query.yield.samples);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Apart tolerance: \033[38;5;190m%.2lf %%\033[0m\n", query.yield.tolerance * 100.0);
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1Awithin max. error: \033[38;5;76m%.2lf %%\033[0m\n", query.yield.within * 100.0);
+	consolePrintf("╟───────────────────────────────────────╢\n");
+	consolePrintf("║ percentile        ┆ ratio error       ║\n");
+
+	for (size_t i = 0; i < size(YIELD_PERCENTILES); i++) {
+
+		consolePrintf("║                   ┆                   ║\n");
+		consolePrintf("  \033[1A \033[38;5;76m%.1lf %%\033[0m\n", YIELD_PERCENTILES[i] * 100.0);
+		consolePrintf("                      \033[1A \033[38;5;190m%.4lf %%\033[0m\n", query.yield.percentiles[i] * 100.0);
+
+	}
+
+	consolePrintf("╚═══════════════════════════════════════╝\n");
+
+}
+
+int main(int argn, const char** argv) {
 
-	wprintf(L"╔═══════════════════════════════════════╗\n");
-	wprintf(L"║                                       ║\n");
-	wprintf(L"  \033[1A\033[38;5;214mfind E tool by M_Marvin\033[0m\n");
-	wprintf(L"╚═══════════════════════════════════════╝\n");
-	
 	// Read in max error and resistor values
-	double maxError = 0.01;
+	QueryOptions options = { 0.01, false, false, false, 0, false, nullptr, 0, 0.0, 0.0, false };
 	vector<double> values = vector<double>();
 	bool ratioMode = false;
 	bool parseValues = true;
+	const char* streamPath = nullptr;
+	const char* serveName = nullptr;
+	OutputFormat format = isatty(fileno(stdout)) ? FORMAT_BOX : FORMAT_TEXT;
+	unsigned threads = 1;
+	unique_ptr<StockIndex> stock;
+	vector<vector<double>> customSeries = vector<vector<double>>();
+	const char* indexPath = nullptr;
+	double cacheEntries = (double) CACHE_ENTRIES;
 	
 	for (int i = 1; i < argn; i++) {
 		string s = string(argv[i]);
 
 		if (s == "-err") {
 			if (argn <= i + 1) return -1;
-			maxError = stod(string(argv[i + 1])) / 100.0;
+			if (!parseValue(argv[i + 1], argv[i + 1] + strlen(argv[i + 1]), &options.maxError)) return -1;
+			options.maxError /= 100.0;
 			parseValues = false;
 		} else if (s == "-ratio") {
 			ratioMode = true;
 			parseValues = false;
+		} else if (s == "-network") {
+			ratioMode = true;
+			options.network = true;
+			parseValues = false;
+		} else if (s == "--sweep") {
+			options.sweep = true;
+		} else if (s == "--minimize-parts") {
+			options.minimize = true;
+		} else if (s == "--chain") {
+			options.chain = true;
+		} else if (s == "-top") {
+			if (argn <= i + 1) return -1;
+			int top = atoi(argv[++i]);
+			if (top < 0 || top > (int) MAX_TOP) return -1;
+			options.top = (unsigned) top;
+		} else if (s == "--yield") {
+			if (argn <= i + 1) return -1;
+			double samples;
+			i++;
+			if (!parseValue(argv[i], argv[i] + strlen(argv[i]), &samples) || samples < 0.0 || samples > MAX_YIELD) return -1;
+			options.yieldSamples = (uint64_t) samples;
+		} else if (s == "--part-tolerance") {
+			if (argn <= i + 1) return -1;
+			i++;
+			if (!parseValue(argv[i], argv[i] + strlen(argv[i]), &options.partTolerance) || options.partTolerance < 0.0 || options.partTolerance >= 100.0) return -1;
+			options.partTolerance /= 100.0;
+		} else if (s == "--tempco") {
+			if (argn <= i + 1) return -1;
+			i++;
+			if (!parseValue(argv[i], argv[i] + strlen(argv[i]), &options.tempco) || options.tempco < 0.0 || options.tempco >= 1e6) return -1;
+			options.tempco /= 1e6;
+		} else if (s == "--stats") {
+#if defined(FIND_E_STATS)
+			options.stats = true;
+#else
+			return -1;
+#endif
+		} else if (s == "--build-index") {
+			if (argn <= i + 1) return -1;
+			return customSeries.empty() && solver.writeIndex(argv[++i]) ? 0 : -1;
+		} else if (s == "--index") {
+			if (argn <= i + 1) return -1;
+			indexPath = argv[++i];
+		} else if (s == "--series") {
+			if (argn <= i + 1) return -1;
+			customSeries.push_back(vector<double>());
+			if (!loadStock(argv[++i], &customSeries.back())) return -1;
+		} else if (s == "--stock") {
+			if (argn <= i + 1) return -1;
+			vector<double> stockValues = vector<double>();
+			if (!loadStock(argv[++i], &stockValues)) return -1;
+			stock = make_unique<StockIndex>(stockValues);
+			options.stock = stock.get();
+		} else if (s == "-f") {
+			if (argn <= i + 1) return -1;
+			streamPath = argv[++i];
+		} else if (s == "--serve") {
+			if (argn <= i + 1) return -1;
+			serveName = argv[++i];
+		} else if (s == "-j") {
+			if (argn <= i + 1) return -1;
+			i++;
+			const char* end = argv[i] + strlen(argv[i]);
+			from_chars_result result = from_chars(argv[i], end, threads);
+			if (result.ec != errc() || result.ptr == argv[i] || result.ptr != end || threads > MAX_THREADS) return -1;
+			if (threads == 0) threads = max(thread::hardware_concurrency(), 1u);
+		} else if (s == "--cache") {
+			if (argn <= i + 1) return -1;
+			i++;
+			if (!parseValue(argv[i], argv[i] + strlen(argv[i]), &cacheEntries) || cacheEntries < 0.0 || cacheEntries > 1e9) return -1;
+		} else if (s == "--format") {
+			if (argn <= i + 1) return -1;
+			string f = string(argv[++i]);
+			if (f == "text") format = FORMAT_TEXT;
+			else if (f == "csv") format = FORMAT_CSV;
+			else if (f == "tsv") format = FORMAT_TSV;
+			else if (f == "json") format = FORMAT_JSON;
+			else return -1;
 		} else if (parseValues) {
-			values.push_back(stod(string(argv[i])));
+			double value;
+			if (!parseValue(argv[i], argv[i] + s.size(), &value)) return -1;
+			values.push_back(value);
+		}
+	}
+
+	// The index only holds the E-series, a missing or outdated one only costs the startup time, the tables are generated instead
+	if (!customSeries.empty()) {
+		if (!solver.useCustomSeries(customSeries)) return -1;
+	} else if (indexPath != nullptr) {
+		solver.loadIndex(indexPath);
+	}
+
+	// Repeated values and ratios of the streaming and server modes are answered from the cache
+	if ((serveName != nullptr || streamPath != nullptr) && cacheEntries >= 1.0) {
+		resultCache = make_unique<ResultCache>((size_t) cacheEntries);
+	}
+
+	// Server mode, answering queries from other processes, the indices are generated before the first client so that no query waits for them
+	if (serveName != nullptr) {
+		solver.prepare();
+		return runServer(serveName, options, format == FORMAT_BOX ? FORMAT_TEXT : format);
+	}
+
+	// The terminal box renderer is only used for a single query on the terminal, and does not show inventory results
+	if (streamPath != nullptr || format != FORMAT_BOX || options.stock != nullptr) {
+		if (format == FORMAT_BOX) format = FORMAT_TEXT;
+		OutputBuffer output = OutputBuffer(stdout);
+		unique_ptr<ResultWriter> writer = createWriter(format, output);
+		StatsSummary summary = StatsSummary();
+		StatsSummary* stats = options.stats ? &summary : nullptr;
+		uint64_t started = statsClock();
+
+		if (streamPath == nullptr) {
+			Query query = Query();
+			query.kind = values.empty() ? QUERY_EMPTY : options.network ? QUERY_NETWORK : ratioMode ? QUERY_RATIO : options.sweep ? QUERY_SWEEP : options.minimize ? QUERY_MINIMIZE : options.chain ? QUERY_CHAIN : QUERY_VALUES;
+			query.maxError = options.maxError;
+			query.top = options.top;
+			query.stock = options.stock;
+			query.yieldSamples = options.yieldSamples;
+			query.partTolerance = options.partTolerance;
+			query.tempco = options.tempco;
+			query.values = values;
+			solveQuery(query);
+			if (query.yieldSamples > 0) {
+				WorkStealingPool pool = WorkStealingPool(max(thread::hardware_concurrency(), 1u));
+				analyseYield(query, &pool);
+			}
+			StageTimer timer = StageTimer(summary.writeTime);
+			writer->begin();
+			writer->write(1, query);
+			summary.add(1, query.stats);
+		} else if (strcmp(streamPath, "-") == 0) {
+			ios::sync_with_stdio(false);
+			WorkStealingPool pool = WorkStealingPool(threads);
+			runStream(cin, options, *writer, pool, threads, stats);
+		} else {
+			ifstream file = ifstream(streamPath);
+			if (!file.is_open()) return -1;
+			WorkStealingPool pool = WorkStealingPool(threads);
+			runStream(file, options, *writer, pool, threads, stats);
 		}
+
+		if (options.stats) {
+			output.flush();
+			summary.wallTime = statsClock() - started;
+			summary.report(format != FORMAT_TEXT);
+		}
+		return 0;
 	}
+
+	consolePrintf("╔═══════════════════════════════════════╗\n");
+	consolePrintf("║                                       ║\n");
+	consolePrintf("  \033[1A\033[38;5;214mfind E tool by M_Marvin\033[0m\n");
+	consolePrintf("╚═══════════════════════════════════════╝\n");
 	
-	// Run actual algorithm to find best values
-	if (ratioMode) {
-		if (values.size() == 0) return -1;
-		findBestForRatio(values[0], maxError);
-	} else {
-		findBestForValues(values, maxError);
+	// Run actual algorithm to find best values, the boxes are counted as a single query without separate stages
+	StatsSummary summary = StatsSummary();
+	QueryStats stats = QueryStats();
+	uint64_t started = statsClock();
+	{
+		StageTimer timer = StageTimer(stats.solveTime);
+		WorkCounter counter = WorkCounter(stats.solver);
+		if (ratioMode) {
+			if (values.size() == 0) return -1;
+			if (options.network) {
+				findBestNetworkForRatio(values[0], options.maxError);
+			} else if (options.top > 0) {
+				findBestPairsForRatio(values[0], options.maxError, options.top);
+			} else {
+				findBestForRatio(values[0], options.maxError);
+			}
+			if (options.yieldSamples > 0 && !options.network) findYieldForRatio(values[0], options);
+		} else if (options.sweep) {
+			findBestForTolerances(values);
+		} else if (options.minimize) {
+			findFewestParts(values, options.maxError);
+		} else if (options.chain) {
+			findLadderForTaps(values, options.maxError);
+		} else {
+			findBestForValues(values, options.maxError);
+		}
+	}
+
+	console.flush();
+	if (options.stats) {
+		summary.wallTime = statsClock() - started;
+		summary.add(1, stats);
+		summary.report(false);
 	}
 	
 	return 0;
@@ -0,0 +1,450 @@
+﻿/*
+* Microbenchmarks of the E-series solver, each one runs the solver side by side with a reference copy of the original algorithms of the find E tool
+* For every benchmark the time per call of both is listed, together with the speedup and how many results of the solver agree with the reference
+* The reference is the tool as it was before the solver library, kept in this file unchanged apart from reading past the end of the fixed series and an unused variable
+* The original tool used other E48 - E192 tables and did not try all pairs, so the ratio searches are also compared against an exhaustive search over the solver's own tables
+* Build it like the tool, from this file and e_series_solver.cpp, and run it with an optional name prefix to only run some of the benchmarks
+*
+* Copyright 2024 M_Marvin (Discord, GitHub)
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*/
+
+
+#include "e_series_solver.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+/* Each side of a benchmark is repeated until it ran at least this long, but at least once */
+static constexpr double BENCHMARK_TIME = 0.25;
+
+/* The seed of the random inputs, so that every run measures the same values */
+static constexpr uint64_t BENCHMARK_SEED = 0x66696E6445;
+
+/* The tolerances of the value benchmarks, and the sizes of their inputs */
+static constexpr double VALUE_TOLERANCES[] = { 0.001, 0.01, 0.1 };
+static constexpr size_t VALUE_COUNTS[] = { 1, 100, 10000, 1000000 };
+
+/* The number of ratios per call of the ratio benchmarks, in the worst case the reference takes about half a minute per ratio */
+static constexpr size_t RATIO_COUNT = 64;
+static constexpr size_t TIGHT_RATIO_COUNT = 2;
+
+/* The values of the cutDown benchmark per call */
+static constexpr size_t CUT_DOWN_COUNT = 4096;
+
+/* Subnormal values mixed into the inputs, their decades are beyond the range of the powers of ten in a single step */
+static constexpr double SUBNORMAL_VALUES[] = { 4.7e-310, 1.5e-315, 2.2e-318 };
+
+/* For historical reasons, these E-series do not match the actual equation, and need to be defined by fixed values */
+static const double E3[] = {1.0, 2.2, 4.7};
+static const double E6[] = {1.0, 1.5, 2.2, 3.3, 4.7, 6.8};
+static const double E12[] = {1.0, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2};
+static const double E24[] = {1.0, 1.1, 1.2, 1.3, 1.5, 1.6, 1.8, 2.0, 2.2, 2.4, 2.7, 3.0, 3.3, 3.6, 3.9, 4.3, 4.7, 5.1, 5.6, 6.2, 6.8, 7.5, 8.2, 9.1};
+
+/*
+* Reference: Transforms a value passed into a value in the range 0.0 - 10.0
+* Example: 0.00456 -> 4.56	12300 -> 1.23
+*/
+double originalCutDown(double d) {
+	if (d < 1.0)
+		while (d < 1.0) d *= 10;
+	else
+		while (d > 10.0) d /= 10;
+	return d;
+}
+
+/*
+* Reference: Tries to find the first E-series, from which values the requested ratio can be made, while stayng below the requested maximal error.
+* The original read ser[n] for the last index, one past the end of the table, this copy uses the first value of the next decade there instead.
+* @param ratio The ratio of the two values
+* @param maxError The maximum error that is acceptable
+* @param error The actual error with the found values
+* @param value1 The first value from the found series
+* @param value2 The second value from the found series
+* @returns The series from which the values where taken
+*/
+int originalFindEseriesForRatio(double ratio, double maxError, double* error, double* value1, double* value2) {
+
+	if (maxError <= 0.0) return 0;
+
+	double r = originalCutDown(ratio);
+	for (uint16_t n = 3; (uint32_t) n * 2 < 0xFFFF; n *= 2) {
+
+		for (uint16_t e1 = 1; e1 <= n; e1++) {
+			for (uint16_t e2 = 1; e2 <= e1; e2++) {
+
+				const double* ser;
+				switch (n) {
+					case 3:
+						ser = E3;
+						goto fix_series;
+					case 6:
+						ser = E6;
+						goto fix_series;
+					case 12:
+						ser = E12;
+						goto fix_series;
+					case 24:
+						ser = E24;
+						goto fix_series;
+
+					fix_series:
+						*value1 = e1 < n ? ser[e1] : ser[0] * 10.0;
+						*value2 = e2 < n ? ser[e2] : ser[0] * 10.0;
+						break;
+
+					default:
+						double r10 = pow(10, 1.0 / n);
+						*value1 = round(pow(r10, e1) * 1000.0) / 1000.0;
+						*value2 = round(pow(r10, e2) * 1000.0) / 1000.0;
+						break;
+				}
+
+				double rat = *value1 / *value2;
+				double err = abs(rat - r) / r;
+
+				if (err <= maxError) {
+					*error = err;
+					while (*value1 / *value2 < ratio) *value1 *= 10;
+					while (*value1 / *value2 > ratio) *value2 *= 10;
+					return n;
+				}
+
+			}
+		}
+
+	}
+
+	return 0;
+
+}
+
+/*
+* Reference: Tries to find the first E-series, which's values are close to the provided values.
+* @param values The values to find a close E-series for
+* @param maxError The maximum error that is acceptable
+* @param largestError Returns the largest error that occurs in the best E-series found
+* @param seriesValues Returns a map that assigns each requested value (transformed to 0.0-10.0) the found E-series value
+* @returns The best series found, or zero if none matched the maximum error
+*/
+int originalFindEseries(vector<double>& values, double maxError, double* largestError, map<double, double>& seriesValues) {
+
+	if (maxError <= 0.0) return 0;
+	seriesValues.clear();
+
+	uint16_t bestSeries = 0;
+	for (uint16_t n = 3; (uint32_t) n * 2 < 0xFFFF; n *= 2) {
+
+		*largestError = 0.0;
+		const double* ser;
+
+		switch (n) {
+		case 3:
+			ser = E3;
+			goto fix_series;
+		case 6:
+			ser = E6;
+			goto fix_series;
+		case 12:
+			ser = E12;
+			goto fix_series;
+		case 24:
+			ser = E24;
+			goto fix_series;
+
+		fix_series:
+			for (const auto value : values) {
+				double v = originalCutDown(value);
+				double smallestError = -1.0;
+				for (uint16_t m = 0; m < n; m++) {
+					double ve = ser[m];
+					double err = abs(ve - v) / v;
+
+					if (err < smallestError || smallestError < 0) {
+						smallestError = err;
+						seriesValues[v] = ve;
+					}
+				}
+				if (smallestError > *largestError) {
+					*largestError = smallestError;
+				}
+			}
+			break;
+
+		default:
+			double r10 = pow(10, 1.0 / n);
+			for (const auto value : values) {
+				double v = originalCutDown(value);
+				uint16_t m = round(log(v) / log(r10));
+				double ve = round(pow(r10, m) * 1000.0) / 1000.0;
+				double err = abs(ve - v) / v;
+
+				seriesValues[v] = ve;
+
+				if (err > *largestError) {
+					*largestError = err;
+				}
+			}
+			break;
+		}
+
+		if (*largestError < maxError) {
+			bestSeries = n;
+			break;
+		}
+
+	}
+
+	return bestSeries;
+
+}
+
+/*
+* Reference: Tries every pair of values of every series, in the order the solver tries them, and returns the first series with a pair within the max. error.
+* The first value can be up to a decade above the second one, the ratio is compared in 1.0 - 10.0 like by the solver.
+* @param solver The solver to take the series values from
+* @param ratio The ratio of the two values
+* @param maxError The maximum error that is acceptable
+* @param error Returns the error of the best pair of the found series
+* @returns The series found, or zero if none matched the maximum error
+*/
+int exhaustiveFindEseriesForRatio(const ESeriesSolver& solver, double ratio, double maxError, double* error) {
+
+	int exponent;
+	double r = cutDown(ratio, &exponent);
+	if (r == 0.0 || maxError <= 0.0) return 0;
+
+	for (size_t s = 0; s < solver.seriesCount(); s++) {
+		span<const double> ser = solver.seriesValues(s);
+		size_t n = ser.size();
+		double best = -1.0;
+		for (size_t e2 = 0; e2 < n; e2++) {
+			for (size_t e1 = e2; e1 <= e2 + n; e1++) {
+				double v1 = e1 < n ? ser[e1] : ser[e1 - n] * 10.0;
+				double err = abs(v1 / ser[e2] - r) / r;
+				if (err < best || best < 0) best = err;
+			}
+		}
+		if (best <= maxError) {
+			*error = best;
+			return (int) n;
+		}
+	}
+
+	return 0;
+
+}
+
+/*
+* Runs a benchmark side until it ran for the benchmark time, and returns the mean time per call in nanoseconds.
+*/
+double measure(const function<void()>& run) {
+	size_t calls = 0;
+	auto start = chrono::steady_clock::now();
+	double elapsed;
+	do {
+		run();
+		calls++;
+		elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	} while (elapsed < BENCHMARK_TIME);
+	return elapsed * 1e9 / calls;
+}
+
+/*
+* One benchmark, the comparison returns the number of results of a call and how many of them agree between both sides.
+* The agreement is taken from the last call of each side, the inputs are the same for every call.
+*/
+struct Benchmark {
+	string name;
+	function<void()> current;
+	function<void()> reference;
+	function<size_t(size_t*)> compare;
+};
+
+/*
+* Random values spread evenly over the decades from 10^low to 10^high, rounded to three digits like the part values of a BOM.
+*/
+vector<double> randomValues(mt19937_64& random, size_t count, int low, int high) {
+	uniform_real_distribution<double> exponent = uniform_real_distribution<double>(low, high);
+	vector<double> values = vector<double>(count);
+	for (double& v : values) {
+		double d = pow(10.0, exponent(random));
+		int e;
+		double m = cutDown(d, &e);
+		v = scaleDecade(round(m * 100.0) / 100.0, e);
+	}
+	return values;
+}
+
+int main(int argn, const char** argv) {
+
+	const char* filter = argn > 1 ? argv[1] : "";
+	ESeriesSolver solver = ESeriesSolver();
+	mt19937_64 random = mt19937_64(BENCHMARK_SEED);
+	vector<Benchmark> benchmarks = vector<Benchmark>();
+
+	// cutDown over the whole range of normal doubles and a few subnormal ones, the reference agrees if its mantissa is within rounding of the solver's,
+	// and if scaleDecade takes the mantissa back to the value, within the rounding of the value's own precision
+	auto cutDownValues = make_shared<vector<double>>(randomValues(random, CUT_DOWN_COUNT, -300, 300));
+	copy(begin(SUBNORMAL_VALUES), end(SUBNORMAL_VALUES), cutDownValues->end() - size(SUBNORMAL_VALUES));
+	auto cutDownResults = make_shared<pair<vector<double>, vector<double>>>(vector<double>(CUT_DOWN_COUNT), vector<double>(CUT_DOWN_COUNT));
+	auto cutDownExponents = make_shared<vector<int>>(CUT_DOWN_COUNT);
+	benchmarks.push_back({ "cutDown/" + to_string(CUT_DOWN_COUNT),
+		[=]() {
+			for (size_t i = 0; i < CUT_DOWN_COUNT; i++) cutDownResults->first[i] = cutDown((*cutDownValues)[i], &(*cutDownExponents)[i]);
+		},
+		[=]() {
+			for (size_t i = 0; i < CUT_DOWN_COUNT; i++) cutDownResults->second[i] = originalCutDown((*cutDownValues)[i]);
+		},
+		[=](size_t* agree) {
+			*agree = 0;
+			for (size_t i = 0; i < CUT_DOWN_COUNT; i++) {
+				// A mantissa within rounding of 10.0 is the same decade boundary as one just above 1.0
+				double current = cutDownResults->first[i];
+				double original = cutDownResults->second[i];
+				if (current >= 10.0 * (1.0 - 1e-12)) current /= 10.0;
+				if (original >= 10.0 * (1.0 - 1e-12)) original /= 10.0;
+				double value = (*cutDownValues)[i];
+				double back = scaleDecade(cutDownResults->first[i], (*cutDownExponents)[i]);
+				if (abs(current - original) <= 1e-12 * current && abs(back - value) <= 1e-12 * value + numeric_limits<double>::denorm_min()) (*agree)++;
+			}
+			return CUT_DOWN_COUNT;
+		}
+	});
+
+	// findEseries, the series of each side are compared, and every published series value has to be within its error of the requested value.
+	// All but the single value case get a subnormal value, whose series value is moved back to its decade in two steps
+	for (size_t count : VALUE_COUNTS) {
+		auto values = make_shared<vector<double>>(randomValues(random, count, -3, 7));
+		if (count > 1) values->back() = SUBNORMAL_VALUES[0];
+		for (double tolerance : VALUE_TOLERANCES) {
+			auto series = make_shared<pair<int, int>>(0, 0);
+			auto matches = make_shared<vector<ValueMatch>>(count);
+			auto workspace = make_shared<ESeriesSolver::Workspace>(count);
+			char name[64];
+			snprintf(name, sizeof(name), "findEseries/%zu/%g%%", count, tolerance * 100.0);
+			benchmarks.push_back({ name,
+				[=, &solver]() {
+					double largestError;
+					series->first = solver.matchValues(*values, tolerance, *matches, *workspace, &largestError);
+				},
+				[=]() {
+					double largestError;
+					map<double, double> seriesValues = map<double, double>();
+					series->second = originalFindEseries(*values, tolerance, &largestError, seriesValues);
+				},
+				[=](size_t* agree) {
+					bool published = true;
+					for (size_t i = 0; series->first != 0 && i < count; i++) {
+						const ValueMatch& match = (*matches)[i];
+						double value = (*values)[i];
+						published = published && match.original == value
+							&& abs(match.seriesValue - value) <= match.error * value * (1.0 + 1e-9) + 1e-12 * value + numeric_limits<double>::denorm_min();
+					}
+					*agree = series->first == series->second && published ? 1 : 0;
+					return (size_t) 1;
+				}
+			});
+		}
+	}
+
+	// findEseriesForRatio, with ratios the fixed series can make, with three digit ratios, and with a tolerance no series meets
+	struct RatioCase {
+		const char* name;
+		double tolerance;
+		size_t count;
+		bool fixed;
+	};
+	const RatioCase ratioCases[] = { { "fixed", 0.005, RATIO_COUNT, true }, { "computed", 0.0005, RATIO_COUNT, false }, { "tight", 1e-9, TIGHT_RATIO_COUNT, false } };
+	for (const RatioCase& ratioCase : ratioCases) {
+		size_t count = ratioCase.count;
+		auto ratios = make_shared<vector<double>>(randomValues(random, count, 0, 1));
+		if (ratioCase.fixed) {
+			uniform_int_distribution<size_t> index = uniform_int_distribution<size_t>(0, size(E24) - 1);
+			for (double& r : *ratios) {
+				double a = E24[index(random)];
+				double b = E24[index(random)];
+				r = max(a, b) / min(a, b);
+			}
+		} else if (ratioCase.tolerance < 1e-6) {
+			// Three digit ratios are made exactly by the largest series, the worst case needs one that is not
+			for (double& r : *ratios) r *= 1.0 + 1e-4 * M_SQRT2;
+		}
+		auto series = make_shared<pair<vector<int>, vector<int>>>(vector<int>(count), vector<int>(count));
+		double tolerance = ratioCase.tolerance;
+		benchmarks.push_back({ string("findEseriesForRatio/") + ratioCase.name,
+			[=, &solver]() {
+				double error, value1, value2;
+				for (size_t i = 0; i < count; i++) series->first[i] = solver.matchRatio((*ratios)[i], tolerance, &error, &value1, &value2);
+			},
+			[=]() {
+				double error, value1, value2;
+				for (size_t i = 0; i < count; i++) series->second[i] = originalFindEseriesForRatio((*ratios)[i], tolerance, &error, &value1, &value2);
+			},
+			[=](size_t* agree) {
+				*agree = 0;
+				for (size_t i = 0; i < count; i++) {
+					if (series->first[i] == series->second[i]) (*agree)++;
+				}
+				return count;
+			}
+		});
+
+		// The exhaustive search is quadratic in the series size, a tolerance no series meets would take hours
+		if (tolerance < 1e-6) continue;
+		auto errors = make_shared<pair<vector<double>, vector<double>>>(vector<double>(count), vector<double>(count));
+		auto exhaustive = make_shared<pair<vector<int>, vector<int>>>(vector<int>(count), vector<int>(count));
+		benchmarks.push_back({ string("findEseriesForRatio/") + ratioCase.name + "/exhaustive",
+			[=, &solver]() {
+				double value1, value2;
+				for (size_t i = 0; i < count; i++) exhaustive->first[i] = solver.matchRatio((*ratios)[i], tolerance, &errors->first[i], &value1, &value2);
+			},
+			[=, &solver]() {
+				for (size_t i = 0; i < count; i++) exhaustive->second[i] = exhaustiveFindEseriesForRatio(solver, (*ratios)[i], tolerance, &errors->second[i]);
+			},
+			[=](size_t* agree) {
+				*agree = 0;
+				for (size_t i = 0; i < count; i++) {
+					if (exhaustive->first[i] == exhaustive->second[i] && (exhaustive->first[i] == 0 || abs(errors->first[i] - errors->second[i]) <= 1e-12)) (*agree)++;
+				}
+				return count;
+			}
+		});
+	}
+
+	printf("%-40s %16s %16s %10s %12s\n", "benchmark", "solver ns", "reference ns", "speedup", "agreement");
+	for (const Benchmark& benchmark : benchmarks) {
+		if (strncmp(benchmark.name.c_str(), filter, strlen(filter)) != 0) continue;
+
+		double current = measure(benchmark.current);
+		double reference = measure(benchmark.reference);
+		size_t agree;
+		size_t total = benchmark.compare(&agree);
+		printf("%-40s %16.0lf %16.0lf %9.1lfx %5zu/%-6zu\n", benchmark.name.c_str(), current, reference, reference / current, agree, total);
+		fflush(stdout);
+	}
+
+	return 0;
+
+}